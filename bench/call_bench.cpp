@@ -0,0 +1,146 @@
+// call_bench.cpp - host->wasm call overhead benchmark
+//
+// Compares the runner's former call paths, 'wasm_runtime_call_wasm_a()'
+// with 'wasm_val_t' arrays and a pair of module mallocs per call for
+// out-parameters, with typed 'wasm_fn' bindings and a 'wasm_scratch'
+// region. Runs against the module built by the 'wasm_module' target.
+
+#include "wasm_export.h"
+
+#include "log_ring.h"
+#include "mapped_file.h"
+#include "wasm_fn.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+using bench_clock = std::chrono::steady_clock;
+
+static constexpr unsigned calls = 200000;
+
+static void _log_func(wasm_exec_env_t, const char *, int) {}
+static void _host_timer_arm(wasm_exec_env_t, uint32_t) {}
+static void _host_queue_stopped(wasm_exec_env_t) {}
+static void _host_thread_exit(wasm_exec_env_t) {}
+
+static NativeSymbol native_symbols[] = {
+  EXPORT_WASM_API_WITH_SIG(_log_func, "(*i)"),
+  EXPORT_WASM_API_WITH_SIG(_host_timer_arm, "(i)"),
+  EXPORT_WASM_API_WITH_SIG(_host_queue_stopped, "()"),
+  EXPORT_WASM_API_WITH_SIG(_host_thread_exit, "()"),
+};
+
+template <typename Func>
+static double run_bench(Func &&func) {
+  auto t0 = bench_clock::now();
+  for (unsigned i = 0; i < calls; i++) {
+    if (!func()) {
+      fprintf(stderr, "call failed\n");
+      return 0;
+    }
+  }
+  auto elapsed = std::chrono::duration<double>(bench_clock::now() - t0);
+  return calls / elapsed.count() / 1e6;
+}
+
+int main(int argc, char *argv[]) {
+  const char *wasm_file = argc > 1 ? argv[1] : "module.wasm";
+
+  mapped_file binary;
+  if (!binary.map(wasm_file)) {
+    fprintf(stderr, "failed to read %s\n", wasm_file);
+    return 1;
+  }
+
+  if (!wasm_runtime_init()) return 1;
+  wasm_runtime_register_natives("env", native_symbols,
+                                sizeof(native_symbols) / sizeof(NativeSymbol));
+
+  char error_buf[128];
+  std::unique_ptr<WASMModuleCommon, void (*)(wasm_module_t)> module(
+      wasm_runtime_load(binary.data(), binary.size(), error_buf,
+                        sizeof(error_buf)),
+      wasm_runtime_unload);
+  if (!module) {
+    fprintf(stderr, "failed to load %s: %s\n", wasm_file, error_buf);
+    return 1;
+  }
+
+  std::unique_ptr<WASMModuleInstanceCommon, void (*)(wasm_module_inst_t)> inst(
+      wasm_runtime_instantiate(module.get(), 64 * 1024, 64 * 1024, error_buf,
+                               sizeof(error_buf)),
+      wasm_runtime_deinstantiate);
+  if (!inst) {
+    fprintf(stderr, "failed to instantiate %s: %s\n", wasm_file, error_buf);
+    return 1;
+  }
+
+  std::unique_ptr<WASMExecEnv, void (*)(wasm_exec_env_t)> exec_env(
+      wasm_runtime_create_exec_env(inst.get(), 64 * 1024),
+      wasm_runtime_destroy_exec_env);
+
+  wasm_fn<uint32_t()> get_module_name;
+  wasm_fn<void(uint32_t, uint32_t)> get_counters;
+  wasm_fn<uint32_t()> get_log_ring;
+  if (!exec_env || !get_module_name.bind(inst.get(), "get_module_name") ||
+      !get_counters.bind(inst.get(), "get_counters")) {
+    fprintf(stderr, "missing exports\n");
+    return 1;
+  }
+
+  // measure calls, not the TRACE lines of 'get_counters'
+  if (get_log_ring.bind(inst.get(), "get_log_ring")) {
+    auto ring = static_cast<log_ring_t *>(wasm_runtime_addr_app_to_native(
+        inst.get(), get_log_ring(exec_env.get())));
+    if (ring) __atomic_store_n(&ring->level, LOG_LEVEL_ERROR, __ATOMIC_RELAXED);
+  }
+
+  auto name_func = wasm_runtime_lookup_function(inst.get(), "get_module_name");
+  auto counters_func = wasm_runtime_lookup_function(inst.get(), "get_counters");
+
+  double name_before = run_bench([&]() {
+    wasm_val_t results[1] = { WASM_I32_VAL(0) };
+    return wasm_runtime_call_wasm_a(exec_env.get(), name_func, 1, results, 0,
+                                    nullptr);
+  });
+  double name_after = run_bench([&]() {
+    return get_module_name(exec_env.get()) != 0;
+  });
+
+  double counters_before = run_bench([&]() {
+    uint32_t *p_ptr = nullptr, *p_len = nullptr;
+    uint32_t ptr_addr = wasm_runtime_module_malloc(inst.get(), sizeof(uint32_t),
+                                                   (void **)&p_ptr);
+    uint32_t len_addr = wasm_runtime_module_malloc(inst.get(), sizeof(uint32_t),
+                                                   (void **)&p_len);
+    if (!ptr_addr || !len_addr) return false;
+    *p_ptr = *p_len = 0;
+
+    uint32_t argv[2] = {ptr_addr, len_addr};
+    bool ok = wasm_runtime_call_wasm(exec_env.get(), counters_func, 2, argv);
+
+    wasm_runtime_module_free(inst.get(), ptr_addr);
+    wasm_runtime_module_free(inst.get(), len_addr);
+    return ok;
+  });
+
+  wasm_scratch scratch;
+  scratch.reserve(inst.get(), 2 * sizeof(uint32_t));
+  double counters_after = run_bench([&]() {
+    get_counters(exec_env.get(), scratch.app(), scratch.app(sizeof(uint32_t)));
+    return true;
+  });
+  scratch.reset();
+
+  printf("%-16s %14s %14s\n", "export", "before Mc/s", "wasm_fn Mc/s");
+  printf("%-16s %14.2f %14.2f\n", "get_module_name", name_before, name_after);
+  printf("%-16s %14.2f %14.2f\n", "get_counters", counters_before,
+         counters_after);
+
+  exec_env.reset();
+  inst.reset();
+  module.reset();
+  wasm_runtime_destroy();
+  return 0;
+}
@@ -0,0 +1,173 @@
+// simd_bench.cpp - bulk kernel throughput, scalar vs simd128 modules
+//
+// Times the module's bulk kernel exports (bulk.cpp) on buffers in the
+// module heap. Each module given on the command line is loaded by the
+// runtime this benchmark was built with: the classic or fast interpreter
+// for .wasm files, as chosen by WAMR_FAST_INTERP, or AOT for .aot files.
+// bench/simd_bench.sh builds and runs all the variants.
+
+#include "wasm_export.h"
+
+#include "log_ring.h"
+#include "mapped_file.h"
+#include "timer_stats.h"
+#include "wasm_fn.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+using bench_clock = std::chrono::steady_clock;
+
+static constexpr unsigned elements = 4096;
+static constexpr double min_seconds = 0.2;
+
+static void _log_func(wasm_exec_env_t, const char *, int) {}
+static void _host_timer_arm(wasm_exec_env_t, uint32_t) {}
+static void _host_queue_stopped(wasm_exec_env_t) {}
+static void _host_thread_exit(wasm_exec_env_t) {}
+
+static NativeSymbol native_symbols[] = {
+  EXPORT_WASM_API_WITH_SIG(_log_func, "(*i)"),
+  EXPORT_WASM_API_WITH_SIG(_host_timer_arm, "(i)"),
+  EXPORT_WASM_API_WITH_SIG(_host_queue_stopped, "()"),
+  EXPORT_WASM_API_WITH_SIG(_host_thread_exit, "()"),
+};
+
+// Million elements per second, over at least 'min_seconds'
+template <typename Func>
+static double run_bench(unsigned elements_per_call, Func &&func) {
+  uint64_t calls = 0;
+  auto t0 = bench_clock::now();
+  std::chrono::duration<double> elapsed;
+  do {
+    for (unsigned i = 0; i < 100; i++) func();
+    calls += 100;
+    elapsed = bench_clock::now() - t0;
+  } while (elapsed.count() < min_seconds);
+  return calls * elements_per_call / elapsed.count() / 1e6;
+}
+
+static const char *running_mode(wasm_module_t module) {
+  if (wasm_runtime_get_module_package_type(module) == Wasm_Module_AoT) {
+    return "aot";
+  }
+#if BENCH_FAST_INTERP
+  return "fast-interp";
+#else
+  return "interp";
+#endif
+}
+
+static bool bench_module(const char *file) {
+  mapped_file binary;
+  if (!binary.map(file)) {
+    fprintf(stderr, "failed to read %s\n", file);
+    return false;
+  }
+
+  char error_buf[128];
+  std::unique_ptr<WASMModuleCommon, void (*)(wasm_module_t)> module(
+      wasm_runtime_load(binary.data(), binary.size(), error_buf,
+                        sizeof(error_buf)),
+      wasm_runtime_unload);
+  if (!module) {
+    // e.g. a simd128 module on a runtime without SIMD
+    fprintf(stderr, "%s: %s\n", file, error_buf);
+    return false;
+  }
+
+  std::unique_ptr<WASMModuleInstanceCommon, void (*)(wasm_module_inst_t)> inst(
+      wasm_runtime_instantiate(module.get(), 64 * 1024, 64 * 1024, error_buf,
+                               sizeof(error_buf)),
+      wasm_runtime_deinstantiate);
+  if (!inst) {
+    fprintf(stderr, "failed to instantiate %s: %s\n", file, error_buf);
+    return false;
+  }
+
+  std::unique_ptr<WASMExecEnv, void (*)(wasm_exec_env_t)> exec_env(
+      wasm_runtime_create_exec_env(inst.get(), 64 * 1024),
+      wasm_runtime_destroy_exec_env);
+
+  wasm_fn<bool()> get_module_simd;
+  wasm_fn<void(uint32_t)> merge_timer_stats;
+  wasm_fn<void(uint32_t, uint32_t, uint32_t)> sum_counters;
+  wasm_fn<void(uint32_t, uint32_t, uint32_t, uint32_t)> pack_timer_batch;
+  wasm_fn<uint32_t()> get_log_ring;
+  if (!exec_env || !get_module_simd.bind(inst.get(), "get_module_simd") ||
+      !merge_timer_stats.bind(inst.get(), "merge_timer_stats") ||
+      !sum_counters.bind(inst.get(), "sum_counters") ||
+      !pack_timer_batch.bind(inst.get(), "pack_timer_batch")) {
+    fprintf(stderr, "%s: missing exports\n", file);
+    return false;
+  }
+
+  if (get_log_ring.bind(inst.get(), "get_log_ring")) {
+    auto ring = static_cast<log_ring_t *>(wasm_runtime_addr_app_to_native(
+        inst.get(), get_log_ring(exec_env.get())));
+    if (ring) __atomic_store_n(&ring->level, LOG_LEVEL_ERROR, __ATOMIC_RELAXED);
+  }
+
+  // totals, values, then 2 cells per batch entry
+  const uint32_t size = 4 * elements * sizeof(uint32_t);
+  wasm_scratch scratch;
+  scratch.reserve(inst.get(), size + sizeof(timer_stats_t));
+  memset(scratch.native(), 0, size + sizeof(timer_stats_t));
+
+  const uint32_t totals = scratch.app();
+  const uint32_t values = scratch.app(elements * sizeof(uint32_t));
+  const uint32_t entries = scratch.app(2 * elements * sizeof(uint32_t));
+  const uint32_t stats = scratch.app(size);
+
+  auto p = scratch.native<uint32_t>(elements * sizeof(uint32_t));
+  for (unsigned i = 0; i < elements; i++) p[i] = i;
+
+  const char *mode = running_mode(module.get());
+  const char *variant = get_module_simd(exec_env.get()) ? "simd" : "scalar";
+  auto report = [&](const char *kernel, double melems) {
+    printf("%-12s %-8s %-18s %10.1f\n", mode, variant, kernel, melems);
+  };
+
+  // 4 histograms of 34 cells, plus 5 counters
+  report("merge_timer_stats", run_bench(4 * 34 + 5, [&]() {
+    merge_timer_stats(exec_env.get(), stats);
+  }));
+  report("sum_counters", run_bench(elements, [&]() {
+    sum_counters(exec_env.get(), totals, values, elements);
+  }));
+  // 'values' stand in for handles: packing never dereferences them
+  report("pack_timer_batch", run_bench(elements, [&]() {
+    pack_timer_batch(exec_env.get(), entries, values, totals, elements);
+  }));
+  fflush(stdout);
+
+  scratch.reset();
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s [--header] <module.wasm|module.aot>...\n",
+            argv[0]);
+    return 1;
+  }
+
+  if (!wasm_runtime_init()) return 1;
+  wasm_runtime_register_natives("env", native_symbols,
+                                sizeof(native_symbols) / sizeof(NativeSymbol));
+
+  int failed = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--header") == 0) {
+      printf("%-12s %-8s %-18s %10s\n", "mode", "module", "kernel",
+             "Melem/s");
+      continue;
+    }
+    if (!bench_module(argv[i])) failed++;
+  }
+
+  wasm_runtime_destroy();
+  return failed ? 1 : 0;
+}
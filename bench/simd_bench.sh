@@ -0,0 +1,40 @@
+#!/bin/sh
+# Builds the interpreter, fast interpreter and SIMD variants side by side
+# and runs simd_bench on each of their modules.
+#
+# usage: bench/simd_bench.sh [build dir] [extra cmake args...]
+set -e
+
+src=$(cd "$(dirname "$0")/.." && pwd)
+out=${1:-"$src/build-simd-bench"}
+[ $# -gt 0 ] && shift
+
+build() {
+  dir="$out/$1"
+  shift
+  cmake -S "$src" -B "$dir" -DCMAKE_BUILD_TYPE=Release \
+    -DWASM_MODULE_BUILD_TYPE=Release "$@" > /dev/null
+  cmake --build "$dir" -j"$(nproc)" > /dev/null
+}
+
+extra="$*"
+# shellcheck disable=SC2086
+build interp -DWAMR_FAST_INTERP=OFF -DWAMR_SIMD=OFF $extra
+# shellcheck disable=SC2086
+build scalar -DWAMR_FAST_INTERP=ON -DWAMR_SIMD=OFF $extra
+# shellcheck disable=SC2086
+build simd -DWAMR_FAST_INTERP=ON -DWAMR_SIMD=ON $extra
+
+# module.aot is only there if wamrc was found
+modules() {
+  for m in "$@"; do
+    [ -f "$m" ] && echo "$m"
+  done
+}
+
+"$out/interp/simd_bench" --header "$out/interp/module.wasm"
+"$out/scalar/simd_bench" $(modules "$out/scalar/module.wasm" \
+  "$out/scalar/module.aot")
+# the SIMD runtime, with the scalar module as its baseline
+"$out/simd/simd_bench" $(modules "$out/scalar/module.wasm" \
+  "$out/simd/module.wasm" "$out/scalar/module.aot" "$out/simd/module.aot")
@@ -0,0 +1,162 @@
+// timer_backend_bench.cpp - compares timer_queue storage backends
+//
+// Runs natively against 'wasm-module/timer_backend.cpp': the timer
+// thread and WAMR are left out so that only the data structure is
+// measured.
+
+#include "timer_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+using namespace std::chrono_literals;
+using bench_clock = std::chrono::steady_clock;
+
+// simulated run time and wall-clock budget per (backend, size) pair
+static constexpr unsigned sim_ticks = 1000;
+static constexpr auto time_budget = 2s;
+
+struct bench_result {
+  double start_ns;
+  double restart_ns;
+  double stop_ns;
+  double fire_ns;
+  unsigned long fired;
+  unsigned ticks;
+};
+
+static double ns_per_op(bench_clock::duration d, unsigned long ops) {
+  if (!ops) return 0.0;
+  return std::chrono::duration<double, std::nano>(d).count() / ops;
+}
+
+static bench_result run_bench(timer_backend_kind kind, size_t n) {
+  std::unique_ptr<timer_handle_t[]> timers(new timer_handle_t[n]());
+  std::vector<timer_handle_t*> order(n);
+  std::vector<timer_handle_t*> expired;
+
+  std::mt19937 rng(42);
+  std::uniform_int_distribution<unsigned> period(1, 1000);
+  for (size_t i = 0; i < n; i++) {
+    timers[i].period = period(rng);
+    timers[i].repeat = true;
+    order[i] = &timers[i];
+  }
+
+  auto backend = make_timer_backend(kind);
+  auto now = bench_clock::now();
+  bench_result res = {};
+
+  // start all timers
+  auto t0 = bench_clock::now();
+  for (auto t : order) {
+    t->expiry = now + t->period * 1ms;
+    backend->insert(t);
+  }
+  res.start_ns = ns_per_op(bench_clock::now() - t0, n);
+
+  // simulate 1ms ticks, re-arming every expired timer
+  t0 = bench_clock::now();
+  while (res.ticks < sim_ticks && bench_clock::now() - t0 < time_budget) {
+    now += 1ms;
+    res.ticks++;
+    backend->expire(now, expired);
+    for (auto t : expired) {
+      t->expiry += t->period * 1ms;
+      backend->insert(t);
+    }
+    res.fired += expired.size();
+    expired.clear();
+  }
+  res.fire_ns = ns_per_op(bench_clock::now() - t0, res.fired);
+
+  // restart already active timers, then stop them, in random order
+  std::shuffle(order.begin(), order.end(), rng);
+  t0 = bench_clock::now();
+  for (auto t : order) {
+    t->expiry = now + t->period * 1ms;
+    backend->insert(t);
+  }
+  res.restart_ns = ns_per_op(bench_clock::now() - t0, n);
+
+  std::shuffle(order.begin(), order.end(), rng);
+  t0 = bench_clock::now();
+  for (auto t : order) {
+    backend->remove(t);
+  }
+  res.stop_ns = ns_per_op(bench_clock::now() - t0, n);
+
+  return res;
+}
+
+// Drives one periodic timer from next_deadline() to next_deadline(), as
+// the timer thread does; returns the number of wakeups that fired nothing.
+static unsigned idle_wakeups(timer_backend_kind kind, unsigned period_ms,
+                             unsigned fires) {
+  timer_handle_t timer = {};
+  timer.period = period_ms;
+  timer.repeat = true;
+
+  auto backend = make_timer_backend(kind);
+  std::vector<timer_handle_t*> expired;
+  timer.expiry = bench_clock::now() + period_ms * 1ms;
+  backend->insert(&timer);
+
+  unsigned wakeups = 0, fired = 0;
+  time_point_t now;
+  while (fired < fires && backend->next_deadline(now)) {
+    wakeups++;
+    backend->expire(now, expired);
+    for (auto t : expired) {
+      t->expiry += t->period * 1ms;
+      backend->insert(t);
+    }
+    fired += expired.size();
+    expired.clear();
+  }
+  return wakeups - fired;
+}
+
+int main() {
+  const size_t sizes[] = {10, 1000, 100000};
+  const struct {
+    timer_backend_kind kind;
+    const char *name;
+  } backends[] = {
+      {timer_backend_kind::vector, "vector"},
+      {timer_backend_kind::wheel, "wheel"},
+  };
+
+  // every wakeup should fire the timer
+  const unsigned periods[] = {1, 50, 200, 500, 5000, 300000};
+  int failed = 0;
+  for (auto &b : backends) {
+    for (auto period : periods) {
+      unsigned idle = idle_wakeups(b.kind, period, 100);
+      if (idle) {
+        printf("%s: %u idle wakeups for 100 fires of a %ums timer\n", b.name,
+               idle, period);
+        failed = 1;
+      }
+    }
+  }
+
+  printf("%-8s %8s %12s %12s %12s %12s %10s %6s\n", "backend", "timers",
+         "start ns/op", "restart ns", "stop ns/op", "fire ns/op", "fired",
+         "ticks");
+
+  for (auto n : sizes) {
+    for (auto &b : backends) {
+      bench_result r = run_bench(b.kind, n);
+      printf("%-8s %8zu %12.1f %12.1f %12.1f %12.1f %10lu %6u\n", b.name, n,
+             r.start_ns, r.restart_ns, r.stop_ns, r.fire_ns, r.fired,
+             r.ticks);
+    }
+  }
+
+  return failed;
+}
@@ -0,0 +1,438 @@
+// wamr_bench.cpp - runtime benchmark suite, run against bench_module.wasm
+//
+// Measures, for each module given on the command line:
+//   call   host->wasm call latency of each export
+//   cmds   timer command throughput, blocking vs '_async' variants, and
+//          command queue contention between wasi threads
+//   fire   timer fire delay percentiles
+//   trace  TRACE cost: filtered out, recorded, or dropped on a full ring
+//   check  timer behaviours a regression would break; fails the run
+//
+// .wasm files run on the interpreter this benchmark was built with
+// (WAMR_FAST_INTERP), .aot files AOT compiled. --json prints one JSON
+// object per result, for regression checks; bench/wamr_bench.sh builds
+// and runs every mode.
+
+#include "wasm_export.h"
+
+#include "host_timer_loop.h"
+#include "log_ring.h"
+#include "mapped_file.h"
+#include "timer_stats.h"
+#include "wasm_fn.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using bench_clock = std::chrono::steady_clock;
+
+static constexpr double min_seconds = 0.2;
+static constexpr uint32_t batch_timers = 16;
+static constexpr uint32_t fire_timers = 64;
+static constexpr uint32_t fire_period_ms = 10;
+static constexpr auto fire_duration = std::chrono::milliseconds(500);
+static constexpr uint32_t timer_cmds = 100000;
+static constexpr uint32_t queue_cmds = 100000;
+static constexpr uint32_t queue_producers[] = {1, 2, 4, 8};
+// the largest producer count, its consumer, and the timer queue's threads
+static constexpr uint32_t max_threads = 16;
+static constexpr uint32_t trace_lines = 1000;
+
+static bool json = false;
+
+static void _log_func(wasm_exec_env_t, const char *, int) {}
+static void _host_timer_arm(wasm_exec_env_t exec_env, uint32_t delay_us) {
+  host_timer_loop::arm(exec_env, delay_us);
+}
+static void _host_queue_stopped(wasm_exec_env_t) {}
+static void _host_thread_exit(wasm_exec_env_t) {}
+
+static NativeSymbol native_symbols[] = {
+  EXPORT_WASM_API_WITH_SIG(_log_func, "(*i)"),
+  EXPORT_WASM_API_WITH_SIG(_host_timer_arm, "(i)"),
+  EXPORT_WASM_API_WITH_SIG(_host_queue_stopped, "()"),
+  EXPORT_WASM_API_WITH_SIG(_host_thread_exit, "()"),
+};
+
+struct bench_context {
+  std::string module;
+  const char *mode;
+};
+
+static void report(const bench_context &ctx, const char *bench,
+                   const std::string &name, double value, const char *unit) {
+  if (json) {
+    printf("{\"module\": \"%s\", \"mode\": \"%s\", \"bench\": \"%s\", "
+           "\"name\": \"%s\", \"value\": %.3f, \"unit\": \"%s\"}\n",
+           ctx.module.c_str(), ctx.mode, bench, name.c_str(), value, unit);
+  } else {
+    printf("%-12s %-6s %-28s %12.2f %s\n", ctx.mode, bench, name.c_str(),
+           value, unit);
+  }
+  fflush(stdout);
+}
+
+// ns per call, over at least 'min_seconds'
+static double time_calls(const std::function<void()> &func) {
+  uint64_t calls = 0;
+  auto t0 = bench_clock::now();
+  std::chrono::duration<double> elapsed;
+  do {
+    for (unsigned i = 0; i < 100; i++) func();
+    calls += 100;
+    elapsed = bench_clock::now() - t0;
+  } while (elapsed.count() < min_seconds);
+  return elapsed.count() * 1e9 / calls;
+}
+
+static const char *running_mode(wasm_module_t module) {
+  if (wasm_runtime_get_module_package_type(module) == Wasm_Module_AoT) {
+    return "aot";
+  }
+#if BENCH_FAST_INTERP
+  return "fast-interp";
+#else
+  return "interp";
+#endif
+}
+
+class bench_instance {
+  std::unique_ptr<WASMModuleInstanceCommon, void (*)(wasm_module_inst_t)> _inst;
+  std::unique_ptr<WASMExecEnv, void (*)(wasm_exec_env_t)> _exec_env;
+  bool _host_timers = false;
+
+public:
+  wasm_scratch scratch;
+  log_ring_t *ring = nullptr;
+
+  bench_instance()
+      : _inst(nullptr, wasm_runtime_deinstantiate),
+        _exec_env(nullptr, wasm_runtime_destroy_exec_env) {}
+
+  ~bench_instance() {
+    scratch.reset();
+    if (_host_timers) host_timer_loop::instance().detach(_inst.get());
+  }
+
+  bool instantiate(wasm_module_t module) {
+    char error_buf[128];
+    _inst.reset(wasm_runtime_instantiate(module, 64 * 1024, 64 * 1024,
+                                         error_buf, sizeof(error_buf)));
+    if (!_inst) {
+      fprintf(stderr, "failed to instantiate: %s\n", error_buf);
+      return false;
+    }
+    _exec_env.reset(wasm_runtime_create_exec_env(_inst.get(), 64 * 1024));
+    if (!_exec_env) return false;
+
+    _host_timers = host_timer_loop::instance().attach(_inst.get(),
+                                                      _exec_env.get());
+
+    wasm_fn<uint32_t()> get_log_ring;
+    if (get_log_ring.bind(_inst.get(), "get_log_ring")) {
+      ring = static_cast<log_ring_t *>(
+          wasm_runtime_addr_app_to_native(_inst.get(), get_log_ring(env())));
+      // measure calls, not their TRACE lines
+      if (ring) set_log_level(LOG_LEVEL_ERROR);
+    }
+
+    scratch.reserve(_inst.get(), 4096);
+    return true;
+  }
+
+  wasm_module_inst_t inst() const { return _inst.get(); }
+  wasm_exec_env_t env() const { return _exec_env.get(); }
+
+  template<typename T = void>
+  T *native(uint32_t app) const {
+    return static_cast<T *>(wasm_runtime_addr_app_to_native(inst(), app));
+  }
+
+  void set_log_level(module_log_level_t level) {
+    __atomic_store_n(&ring->level, level, __ATOMIC_RELAXED);
+  }
+
+  void drain_log() {
+    log_record_t rec;
+    while (log_ring_read(*ring, rec)) {}
+  }
+};
+
+// Creates 'count' repeating timers in the scratch region, after 'offset'
+static uint32_t create_timers(bench_instance &b, uint32_t offset,
+                              uint32_t count, uint32_t period) {
+  wasm_fn<uint32_t(uint32_t, uint32_t, uint32_t, uint32_t)> create;
+  if (!create.bind(b.inst(), "create_timers_batch")) return 0;
+  return create(b.env(), b.scratch.app(offset), count, period, 0);
+}
+
+static void destroy_timers(bench_instance &b, uint32_t offset,
+                           uint32_t count) {
+  wasm_fn<void(uint32_t, uint32_t)> stop, destroy;
+  if (stop.bind(b.inst(), "stop_timers_batch")) {
+    stop(b.env(), b.scratch.app(offset), count);
+  }
+  if (destroy.bind(b.inst(), "destroy_timers_batch")) {
+    destroy(b.env(), b.scratch.app(offset), count);
+  }
+}
+
+static void bench_fire(const bench_context &ctx, bench_instance &b) {
+  wasm_fn<void(uint32_t, uint32_t)> start;
+  wasm_fn<uint32_t()> get_timer_stats;
+  if (!start.bind(b.inst(), "start_timers_batch") ||
+      !get_timer_stats.bind(b.inst(), "get_timer_stats")) {
+    return;
+  }
+
+  uint32_t n = create_timers(b, 0, fire_timers, fire_period_ms);
+  start(b.env(), b.scratch.app(), n);
+  std::this_thread::sleep_for(fire_duration);
+
+  timer_stats_t stats;
+  memcpy(&stats, b.native(get_timer_stats(b.env())), sizeof(stats));
+  destroy_timers(b, 0, n);
+
+  const timer_histogram_t &h = stats.fire_delay_us;
+  report(ctx, "fire", "fire_delay_p50", timer_hist_percentile(h, 50), "us");
+  report(ctx, "fire", "fire_delay_p99", timer_hist_percentile(h, 99), "us");
+  report(ctx, "fire", "fire_delay_max", h.max, "us");
+  report(ctx, "fire", "fired", h.count, "timers");
+}
+
+static void bench_calls(const bench_context &ctx, bench_instance &b) {
+  auto inst = b.inst();
+  auto env = b.env();
+  auto call = [&](const char *name, const std::function<void()> &func) {
+    report(ctx, "call", name, time_calls(func), "ns");
+  };
+
+  wasm_fn<void()> noop;
+  if (noop.bind(inst, "bench_noop")) {
+    call("bench_noop", [&]() { noop(env); });
+  }
+  wasm_fn<uint32_t(uint32_t, uint32_t, uint32_t, uint32_t)> args;
+  if (args.bind(inst, "bench_args")) {
+    call("bench_args", [&]() { args(env, 1, 2, 3, 4); });
+  }
+
+  // getters
+  for (const char *name : {"get_module_name", "get_counter_region",
+                           "get_log_ring", "get_timer_stats"}) {
+    wasm_fn<uint32_t()> getter;
+    if (getter.bind(inst, name)) call(name, [&]() { getter(env); });
+  }
+  wasm_fn<bool()> get_module_simd;
+  if (get_module_simd.bind(inst, "get_module_simd")) {
+    call("get_module_simd", [&]() { get_module_simd(env); });
+  }
+
+  // scratch: out-parameters / counters, timer IDs, periods, then stats
+  const uint32_t ids = 1024, periods = 2048, stats = 2560;
+  wasm_fn<void(uint32_t, uint32_t)> get_counters;
+  if (get_counters.bind(inst, "get_counters")) {
+    call("get_counters", [&]() {
+      get_counters(env, b.scratch.app(), b.scratch.app(sizeof(uint32_t)));
+    });
+  }
+  wasm_fn<void(uint32_t, uint32_t, uint32_t)> sum_counters;
+  if (sum_counters.bind(inst, "sum_counters")) {
+    call("sum_counters", [&]() {
+      sum_counters(env, b.scratch.app(), b.scratch.app(64), 16);
+    });
+  }
+  wasm_fn<void(uint32_t)> merge_timer_stats;
+  if (merge_timer_stats.bind(inst, "merge_timer_stats")) {
+    memset(b.scratch.native(stats), 0, sizeof(timer_stats_t));
+    call("merge_timer_stats", [&]() {
+      merge_timer_stats(env, b.scratch.app(stats));
+    });
+  }
+
+  wasm_fn<void()> create, start, stop;
+  if (create.bind(inst, "create_timers") && start.bind(inst, "start_timers") &&
+      stop.bind(inst, "stop_timers")) {
+    create(env);
+    call("start_timers", [&]() { start(env); });
+    call("stop_timers", [&]() { stop(env); });
+  }
+
+  uint32_t n = create_timers(b, ids, batch_timers, 1000);
+  auto p = b.scratch.native<uint32_t>(periods);
+  for (uint32_t i = 0; i < n; i++) p[i] = 1000 + i;
+
+  wasm_fn<void(uint32_t, uint32_t)> start_batch, stop_batch;
+  if (start_batch.bind(inst, "start_timers_batch") &&
+      stop_batch.bind(inst, "stop_timers_batch")) {
+    call("start_timers_batch", [&]() {
+      start_batch(env, b.scratch.app(ids), n);
+    });
+    call("stop_timers_batch", [&]() {
+      stop_batch(env, b.scratch.app(ids), n);
+    });
+  }
+  wasm_fn<void(uint32_t, uint32_t, uint32_t)> set_periods;
+  if (set_periods.bind(inst, "set_timer_periods_batch")) {
+    call("set_timer_periods_batch", [&]() {
+      set_periods(env, b.scratch.app(ids), b.scratch.app(periods), n);
+    });
+  }
+  destroy_timers(b, ids, n);
+}
+
+static void bench_cmds(const bench_context &ctx, bench_instance &b) {
+  wasm_fn<uint32_t(uint32_t, bool)> cmds;
+  if (!cmds.bind(b.inst(), "bench_timer_cmds")) return;
+
+  for (bool async : {false, true}) {
+    auto t0 = bench_clock::now();
+    uint32_t sent = cmds(b.env(), timer_cmds, async);
+    std::chrono::duration<double> elapsed = bench_clock::now() - t0;
+
+    std::string name = async ? "timer_cmds_async" : "timer_cmds";
+    report(ctx, "cmds", name, sent / elapsed.count() / 1e6, "Mcmd/s");
+    if (async) {
+      report(ctx, "cmds", name + "_accepted", 100.0 * sent / timer_cmds, "%");
+    }
+  }
+
+  // per producer count: former mutex-guarded deque, blocking and
+  // try_lock, then the lock-free ring (see bench_cmd_queue)
+  wasm_fn<uint32_t(uint32_t, uint32_t, uint32_t)> queue;
+  if (!queue.bind(b.inst(), "bench_cmd_queue")) return;
+
+  static const char *const kinds[] = {"mutex", "try_lock", "ring"};
+  for (uint32_t producers : queue_producers) {
+    for (uint32_t kind = 0; kind < 3; kind++) {
+      uint32_t us = queue(b.env(), producers, queue_cmds, kind);
+      if (!us) continue;
+      report(ctx, "cmds",
+             std::string("queue_") + kinds[kind] + "_p" +
+                 std::to_string(producers),
+             (double)producers * queue_cmds / us, "Mcmd/s");
+    }
+  }
+}
+
+static void bench_trace(const bench_context &ctx, bench_instance &b) {
+  wasm_fn<void(uint32_t)> trace;
+  if (!b.ring || !trace.bind(b.inst(), "bench_trace")) return;
+
+  b.set_log_level(LOG_LEVEL_ERROR);
+  report(ctx, "trace", "trace_filtered",
+         time_calls([&]() { trace(b.env(), trace_lines); }) / trace_lines,
+         "ns");
+
+  // one ring's worth per call, drained in between
+  b.set_log_level(LOG_LEVEL_INFO);
+  std::chrono::duration<double> elapsed{0};
+  uint64_t lines = 0;
+  while (elapsed.count() < min_seconds) {
+    b.drain_log();
+    auto t0 = bench_clock::now();
+    trace(b.env(), LOG_RING_RECORDS);
+    elapsed += bench_clock::now() - t0;
+    lines += LOG_RING_RECORDS;
+  }
+  report(ctx, "trace", "trace_recorded", elapsed.count() * 1e9 / lines, "ns");
+
+  report(ctx, "trace", "trace_dropped",
+         time_calls([&]() { trace(b.env(), trace_lines); }) / trace_lines,
+         "ns");
+
+  b.set_log_level(LOG_LEVEL_ERROR);
+  b.drain_log();
+}
+
+// A callback stopping a timer expiring in the same tick must keep it from
+// firing.
+static bool check_stop_in_batch(const bench_context &ctx, bench_instance &b) {
+  wasm_fn<uint32_t(uint32_t)> stop_in_batch;
+  if (!stop_in_batch.bind(b.inst(), "bench_stop_in_batch")) return true;
+
+  uint32_t fires = stop_in_batch(b.env(), 5);
+  report(ctx, "check", "stop_in_batch_fires", fires, "fires");
+  if (fires != 1) {
+    fprintf(stderr, "%s: a timer stopped in its own tick fired %u times\n",
+            ctx.module.c_str(), fires - 1);
+    return false;
+  }
+  return true;
+}
+
+static bool bench_module(const char *file) {
+  mapped_file binary;
+  if (!binary.map(file)) {
+    fprintf(stderr, "failed to read %s\n", file);
+    return false;
+  }
+
+  char error_buf[128];
+  std::unique_ptr<WASMModuleCommon, void (*)(wasm_module_t)> module(
+      wasm_runtime_load(binary.data(), binary.size(), error_buf,
+                        sizeof(error_buf)),
+      wasm_runtime_unload);
+  if (!module) {
+    fprintf(stderr, "%s: %s\n", file, error_buf);
+    return false;
+  }
+
+  bench_context ctx;
+  ctx.module = strrchr(file, '/') ? strrchr(file, '/') + 1 : file;
+  ctx.mode = running_mode(module.get());
+
+  bool passed;
+  {
+    bench_instance b;
+    if (!b.instantiate(module.get())) return false;
+
+    // first, before other timers have fired into the histogram
+    bench_fire(ctx, b);
+    bench_calls(ctx, b);
+    bench_cmds(ctx, b);
+    bench_trace(ctx, b);
+    passed = check_stop_in_batch(ctx, b);
+
+    wasm_fn<void()> cleanup;
+    if (cleanup.bind(b.inst(), "cleanup")) cleanup(b.env());
+  }
+  return passed;
+}
+
+int main(int argc, char *argv[]) {
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else {
+      files.push_back(argv[i]);
+    }
+  }
+  if (files.empty()) {
+    fprintf(stderr, "usage: %s [--json] <bench_module.wasm|.aot>...\n",
+            argv[0]);
+    return 1;
+  }
+
+  RuntimeInitArgs init_args;
+  memset(&init_args, 0, sizeof(init_args));
+  init_args.mem_alloc_type = Alloc_With_System_Allocator;
+  init_args.max_thread_num = max_threads;
+  if (!wasm_runtime_full_init(&init_args)) return 1;
+  wasm_runtime_register_natives("env", native_symbols,
+                                sizeof(native_symbols) / sizeof(NativeSymbol));
+
+  int failed = 0;
+  for (const char *file : files) {
+    if (!bench_module(file)) failed++;
+  }
+
+  wasm_runtime_destroy();
+  return failed ? 1 : 0;
+}
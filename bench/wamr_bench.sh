@@ -0,0 +1,36 @@
+#!/bin/sh
+# Builds the classic and fast interpreter variants, then runs wamr_bench on
+# bench_module.wasm with each, and on bench_module.aot. Results are JSON
+# lines, one object per result.
+#
+# usage: bench/wamr_bench.sh [results file] [build dir] [extra cmake args...]
+set -e
+
+src=$(cd "$(dirname "$0")/.." && pwd)
+results=${1:-wamr_bench.json}
+[ $# -gt 0 ] && shift
+out=${1:-"$src/build-wamr-bench"}
+[ $# -gt 0 ] && shift
+
+build() {
+  dir="$out/$1"
+  shift
+  cmake -S "$src" -B "$dir" -DCMAKE_BUILD_TYPE=Release \
+    -DWASM_MODULE_BUILD_TYPE=Release "$@" > /dev/null
+  cmake --build "$dir" -j"$(nproc)" > /dev/null
+}
+
+extra="$*"
+# shellcheck disable=SC2086
+build interp -DWAMR_FAST_INTERP=OFF $extra
+# shellcheck disable=SC2086
+build fast-interp -DWAMR_FAST_INTERP=ON $extra
+
+"$out/interp/wamr_bench" --json "$out/interp/bench_module.wasm" > "$results"
+set -- "$out/fast-interp/bench_module.wasm"
+# only there if wamrc was found
+[ -f "$out/fast-interp/bench_module.aot" ] &&
+  set -- "$@" "$out/fast-interp/bench_module.aot"
+"$out/fast-interp/wamr_bench" --json "$@" >> "$results"
+
+echo "$(wc -l < "$results") results in $results"
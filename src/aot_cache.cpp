@@ -0,0 +1,166 @@
+#include "aot_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <utility>
+
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+// FNV-1a
+static uint64_t hash64(const void *data, size_t size,
+                       uint64_t h = 0xcbf29ce484222325ull) {
+  auto p = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    h = (h ^ p[i]) * 0x100000001b3ull;
+  }
+  return h;
+}
+
+static std::string machine() {
+  struct utsname u;
+  return uname(&u) == 0 ? u.machine : "";
+}
+
+// Machine name and feature flags of the first CPU
+static const std::string &cpu_features() {
+  static const std::string features = []() {
+    std::string id = machine();
+
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+      // "flags" on x86, "Features" on Arm
+      if (line.compare(0, 5, "flags") == 0 ||
+          line.compare(0, 8, "Features") == 0) {
+        id += line.substr(line.find(':') + 1);
+        break;
+      }
+    }
+    return id;
+  }();
+  return features;
+}
+
+static bool make_dirs(const std::string &dir) {
+  for (size_t pos = 1; pos <= dir.size(); pos++) {
+    if (pos < dir.size() && dir[pos] != '/') continue;
+    if (mkdir(dir.substr(0, pos).c_str(), 0755) != 0 && errno != EEXIST) {
+      return false;
+    }
+  }
+  return true;
+}
+
+aot_cache::aot_cache(std::string dir) : _dir(std::move(dir))
+{
+  if (!_dir.empty()) return;
+
+  if (const char *env = getenv("WAMR_AOT_CACHE")) {
+    _dir = env;
+  } else if (const char *xdg = getenv("XDG_CACHE_HOME")) {
+    _dir = std::string(xdg) + "/wamr_runner";
+  } else if (const char *home = getenv("HOME")) {
+    _dir = std::string(home) + "/.cache/wamr_runner";
+  } else {
+    _dir = "/tmp/wamr_runner";
+  }
+}
+
+std::string aot_cache::key(const uint8_t *wasm, size_t size)
+{
+  const std::string &cpu = cpu_features();
+  char buf[40];
+  snprintf(buf, sizeof(buf), "%016llx-%08llx",
+           (unsigned long long)hash64(wasm, size),
+           (unsigned long long)(hash64(cpu.data(), cpu.size()) & 0xffffffff));
+  return buf;
+}
+
+std::string aot_cache::artifact_key(const uint8_t *wasm, size_t size,
+                                    const std::string &cpu)
+{
+  if (cpu == "native") return key(wasm, size);
+
+  char buf[24];
+  snprintf(buf, sizeof(buf), "%016llx-",
+           (unsigned long long)hash64(wasm, size));
+  return buf + (cpu.empty() ? "generic" : cpu) + "-" + machine();
+}
+
+// next to the .aot
+static std::string artifact_key_path(const std::string &aot_file)
+{
+  return aot_file + ".key";
+}
+
+std::string aot_cache::read_artifact_key(const std::string &aot_file)
+{
+  std::string path = artifact_key_path(aot_file);
+  // written after the .aot: an older one belongs to a previous build
+  if (!is_up_to_date(path, aot_file)) return std::string();
+
+  std::ifstream in(path);
+  std::string key;
+  std::getline(in, key);
+  return key;
+}
+
+bool aot_cache::write_artifact_key(const std::string &aot_file,
+                                   const std::string &key)
+{
+  std::ofstream out(artifact_key_path(aot_file), std::ios::trunc);
+  return (bool)(out << key << std::endl);
+}
+
+std::string aot_cache::path(const std::string &key) const
+{
+  return _dir + "/" + key + ".aot";
+}
+
+bool aot_cache::load(const std::string &key, mapped_file &aot) const
+{
+  return aot.map(path(key));
+}
+
+bool aot_cache::store(const std::string &key,
+                      const std::string &aot_file) const
+{
+  if (!make_dirs(_dir)) return false;
+
+  std::ifstream in(aot_file, std::ios::binary);
+  if (!in.is_open()) return false;
+
+  std::string tmp = path(key) + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!(out << in.rdbuf())) {
+      out.close();
+      unlink(tmp.c_str());
+      return false;
+    }
+  }
+  if (rename(tmp.c_str(), path(key).c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+void aot_cache::remove(const std::string &key) const
+{
+  unlink(path(key).c_str());
+}
+
+bool is_up_to_date(const std::string &path, const std::string &other)
+{
+  struct stat st, other_st;
+  if (stat(path.c_str(), &st) != 0) return false;
+  if (stat(other.c_str(), &other_st) != 0) return true;
+  return st.st_mtim.tv_sec > other_st.st_mtim.tv_sec ||
+         (st.st_mtim.tv_sec == other_st.st_mtim.tv_sec &&
+          st.st_mtim.tv_nsec >= other_st.st_mtim.tv_nsec);
+}
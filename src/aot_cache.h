@@ -0,0 +1,52 @@
+#ifndef AOT_CACHE_H
+#define AOT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "mapped_file.h"
+
+// On-disk cache of AOT compiled modules.
+//
+// Entries are keyed by the content of the .wasm they were compiled from
+// and by the host CPU features, so that neither a stale artifact nor one
+// copied from another machine is picked up.
+class aot_cache {
+  std::string _dir;
+
+  std::string path(const std::string &key) const;
+
+public:
+  // Empty 'dir': $WAMR_AOT_CACHE, $XDG_CACHE_HOME/wamr_runner or
+  // ~/.cache/wamr_runner
+  explicit aot_cache(std::string dir = std::string());
+
+  const std::string &dir() const { return _dir; }
+
+  static std::string key(const uint8_t *wasm, size_t size);
+
+  // What a .aot was compiled from and for, 'cpu' as given to wamrc --cpu
+  // (empty: the generic CPU of this machine's architecture). Equals key()
+  // for "native".
+  static std::string artifact_key(const uint8_t *wasm, size_t size,
+                                  const std::string &cpu);
+
+  // Key recorded next to 'aot_file' by the aot_key tool; empty if there is
+  // none, or if it is older than the .aot itself
+  static std::string read_artifact_key(const std::string &aot_file);
+  static bool write_artifact_key(const std::string &aot_file,
+                                 const std::string &key);
+
+  bool load(const std::string &key, mapped_file &aot) const;
+
+  // Copies 'aot_file' into the cache; readers never see a partial entry.
+  bool store(const std::string &key, const std::string &aot_file) const;
+
+  void remove(const std::string &key) const;
+};
+
+// Whether 'path' exists and was modified no earlier than 'other'
+bool is_up_to_date(const std::string &path, const std::string &other);
+
+#endif // AOT_CACHE_H
@@ -0,0 +1,29 @@
+// aot_key.cpp - records what a .aot was compiled from and for
+//
+// Run by the wasm_module_aot target right after wamrc. wamr_runner only
+// loads, and caches, a .aot found next to a .wasm if the key written here
+// matches that .wasm and the CPU it runs on.
+#include "aot_cache.h"
+
+#include <iostream>
+
+int main(int argc, char *argv[]) {
+  if (argc < 3 || argc > 4) {
+    std::cerr << "Usage: " << argv[0] << " <wasm_file> <aot_file> [cpu]"
+              << std::endl;
+    return 1;
+  }
+
+  mapped_file wasm;
+  if (!wasm.map(argv[1])) {
+    std::cerr << "Failed to read " << argv[1] << std::endl;
+    return 1;
+  }
+  std::string cpu = argc > 3 ? argv[3] : "";
+  if (!aot_cache::write_artifact_key(
+          argv[2], aot_cache::artifact_key(wasm.data(), wasm.size(), cpu))) {
+    std::cerr << "Failed to write the key of " << argv[2] << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,68 @@
+#ifndef CALL_PROFILE_H
+#define CALL_PROFILE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+// Host->wasm calls of one export, over every instance
+struct wasm_call_stats {
+  std::atomic<uint64_t> calls = {0};
+  std::atomic<uint64_t> total_ns = {0};
+  std::atomic<uint64_t> max_ns = {0};
+
+  void add(std::chrono::steady_clock::duration elapsed) {
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        elapsed).count();
+    calls.fetch_add(1, std::memory_order_relaxed);
+    total_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t max = max_ns.load(std::memory_order_relaxed);
+    while (ns > max && !max_ns.compare_exchange_weak(
+                           max, ns, std::memory_order_relaxed)) {
+    }
+  }
+};
+
+// Host-side time of wasm_fn calls, per export name. Only the exports bound
+// once profiling is enabled are timed; the others cost nothing.
+class wasm_call_profile {
+  static std::mutex &mutex() {
+    static std::mutex m;
+    return m;
+  }
+  // node-based: entries never move
+  static std::map<std::string, wasm_call_stats> &exports() {
+    static std::map<std::string, wasm_call_stats> e;
+    return e;
+  }
+  static std::atomic<bool> &enabled_flag() {
+    static std::atomic<bool> enabled = {false};
+    return enabled;
+  }
+
+public:
+  // Before binding the exports to time
+  static void enable() { enabled_flag() = true; }
+  static bool enabled() { return enabled_flag(); }
+
+  // Null while profiling is disabled
+  static wasm_call_stats *stats(const char *name) {
+    if (!enabled()) return nullptr;
+    std::lock_guard<std::mutex> lock(mutex());
+    return &exports()[name];
+  }
+
+  // f(name, stats) for every export called at least once
+  template<typename F>
+  static void for_each(F f) {
+    std::lock_guard<std::mutex> lock(mutex());
+    for (const auto &e : exports()) {
+      if (e.second.calls) f(e.first, e.second);
+    }
+  }
+};
+
+#endif // CALL_PROFILE_H
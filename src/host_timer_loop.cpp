@@ -0,0 +1,199 @@
+#include "host_timer_loop.h"
+
+#include <cerrno>
+#include <cstdio>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+// TIMER_HOST_DISARM, shared with the WASM module
+#include "host_timer.h"
+#include "perf_profile.h"
+
+host_timer_loop &host_timer_loop::instance()
+{
+  static host_timer_loop loop;
+  return loop;
+}
+
+bool host_timer_loop::start()
+{
+  _epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  _event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (_epoll_fd < 0 || _event_fd < 0) {
+    perror("host_timer_loop");
+    stop();
+    return false;
+  }
+
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = _event_fd;
+  epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _event_fd, &ev);
+
+  _running = true;
+  _thread = std::make_unique<std::thread>([this]() { run(); });
+  return true;
+}
+
+void host_timer_loop::stop()
+{
+  if (_thread) {
+    _running = false;
+    uint64_t one = 1;
+    if (write(_event_fd, &one, sizeof(one)) < 0) perror("host_timer_loop");
+    _thread->join();
+    _thread.reset();
+  }
+
+  if (_event_fd >= 0) close(_event_fd);
+  if (_epoll_fd >= 0) close(_epoll_fd);
+  _event_fd = _epoll_fd = -1;
+}
+
+bool host_timer_loop::attach(wasm_module_inst_t module_inst,
+                             wasm_exec_env_t exec_env)
+{
+  auto poll_func = wasm_runtime_lookup_function(module_inst, "timer_host_poll");
+  if (!poll_func) return false;
+
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0) {
+    perror("timerfd_create");
+    return false;
+  }
+
+  std::unique_ptr<instance_t> inst(new instance_t{
+      module_inst, nullptr, poll_func,
+      wasm_runtime_lookup_function(module_inst, "timer_host_thread_init"),
+      false, fd, 0});
+
+  // before spawning: threads of the instance inherit its custom data
+  wasm_runtime_set_custom_data(module_inst, inst.get());
+  inst->exec_env = wasm_runtime_spawn_exec_env(exec_env);
+  if (!inst->exec_env) {
+    std::fprintf(stderr, "host_timer_loop: failed to spawn exec env\n");
+    wasm_runtime_set_custom_data(module_inst, nullptr);
+    close(fd);
+    return false;
+  }
+  wasm_runtime_set_custom_data(wasm_runtime_get_module_inst(inst->exec_env),
+                               inst.get());
+
+  std::lock_guard<std::mutex> lifecycle(_lifecycle_mutex);
+  if (!_thread && !start()) {
+    wasm_runtime_destroy_spawned_exec_env(inst->exec_env);
+    wasm_runtime_set_custom_data(module_inst, nullptr);
+    close(fd);
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  epoll_event ev = {};
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+
+  _instances.emplace(fd, std::move(inst));
+  return true;
+}
+
+void host_timer_loop::detach(wasm_module_inst_t module_inst)
+{
+  auto inst = (instance_t *)wasm_runtime_get_custom_data(module_inst);
+  if (!inst) return;
+
+  // a concurrent attach() waits for the loop to be stopped, then starts
+  // a new one
+  std::lock_guard<std::mutex> lifecycle(_lifecycle_mutex);
+  bool last;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    wasm_runtime_set_custom_data(module_inst, nullptr);
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, inst->timer_fd, nullptr);
+    close(inst->timer_fd);
+    wasm_runtime_destroy_spawned_exec_env(inst->exec_env);
+
+    _instances.erase(inst->timer_fd);
+    last = _instances.empty();
+  }
+
+  if (last) stop();
+}
+
+uint64_t host_timer_loop::cpu_time_ns(wasm_module_inst_t module_inst)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto inst = (instance_t *)wasm_runtime_get_custom_data(module_inst);
+  return inst ? inst->cpu_ns : 0;
+}
+
+void host_timer_loop::arm(wasm_exec_env_t exec_env, uint32_t delay_us)
+{
+  auto inst = (instance_t *)wasm_runtime_get_custom_data(
+      wasm_runtime_get_module_inst(exec_env));
+  if (!inst) return;
+
+  itimerspec spec = {};
+  if (delay_us != TIMER_HOST_DISARM) {
+    // a zero it_value would disarm the timer
+    uint64_t ns = delay_us ? (uint64_t)delay_us * 1000 : 1;
+    spec.it_value.tv_sec = ns / 1000000000;
+    spec.it_value.tv_nsec = ns % 1000000000;
+  }
+  timerfd_settime(inst->timer_fd, 0, &spec, nullptr);
+}
+
+void host_timer_loop::poll(instance_t &inst)
+{
+  uint64_t cpu_start = thread_cpu_ns();
+  if (!inst.thread_init_done) {
+    if (inst.thread_init_func) {
+      wasm_runtime_call_wasm(inst.exec_env, inst.thread_init_func, 0, nullptr);
+    }
+    inst.thread_init_done = true;
+  }
+
+  if (!wasm_runtime_call_wasm(inst.exec_env, inst.poll_func, 0, nullptr)) {
+    std::fprintf(stderr, "timer_host_poll: %s\n",
+                 wasm_runtime_get_exception(
+                     wasm_runtime_get_module_inst(inst.exec_env)));
+  }
+  inst.cpu_ns += thread_cpu_ns() - cpu_start;
+}
+
+void host_timer_loop::run()
+{
+  wasm_runtime_init_thread_env();
+
+  epoll_event events[16];
+  while (_running) {
+    int n = epoll_wait(_epoll_fd, events, 16, -1);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      perror("epoll_wait");
+      break;
+    }
+
+    for (int i = 0; i < n; i++) {
+      int fd = events[i].data.fd;
+      if (fd == _event_fd) continue;
+
+      // fails if re-armed since it fired: it will fire again
+      uint64_t expirations;
+      if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        continue;
+      }
+
+      std::lock_guard<std::mutex> lock(_mutex);
+      auto it = _instances.find(fd);
+      if (it != _instances.end()) {
+        poll(*it->second);
+      }
+    }
+  }
+
+  wasm_runtime_destroy_thread_env();
+}
@@ -0,0 +1,69 @@
+#ifndef HOST_TIMER_LOOP_H
+#define HOST_TIMER_LOOP_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "wasm_export.h"
+
+// One epoll thread driving the timers of every attached module instance.
+//
+// Modules built with TIMER_DRIVER=host have no timer thread: they arm a
+// per-instance timerfd through the '_host_timer_arm' import, and this
+// thread calls their 'timer_host_poll' export when it expires.
+class host_timer_loop {
+  struct instance_t {
+    wasm_module_inst_t module_inst;
+    // spawned from the instance's main exec env, used by the loop only
+    wasm_exec_env_t exec_env;
+    wasm_function_inst_t poll_func;
+    wasm_function_inst_t thread_init_func;
+    bool thread_init_done;
+    int timer_fd;
+    // spent polling the instance
+    uint64_t cpu_ns;
+  };
+
+  int _epoll_fd = -1;
+  // wakes the loop up to stop it
+  int _event_fd = -1;
+
+  std::unique_ptr<std::thread> _thread;
+  std::atomic<bool> _running = {false};
+
+  // held while polling an instance, so that it cannot be detached meanwhile
+  std::mutex _mutex;
+  // held by attach() / detach() across the start / stop decision; never
+  // taken by the loop, so that stop() can join it
+  std::mutex _lifecycle_mutex;
+  std::map<int, std::unique_ptr<instance_t>> _instances;
+
+  host_timer_loop() = default;
+
+  bool start();
+  void stop();
+  void run();
+  void poll(instance_t &inst);
+
+public:
+  host_timer_loop(const host_timer_loop&) = delete;
+  void operator=(const host_timer_loop&) = delete;
+
+  static host_timer_loop &instance();
+
+  // Returns false if the module does not export 'timer_host_poll'.
+  bool attach(wasm_module_inst_t module_inst, wasm_exec_env_t exec_env);
+  void detach(wasm_module_inst_t module_inst);
+
+  // CPU time the loop spent in the instance's timer callbacks
+  uint64_t cpu_time_ns(wasm_module_inst_t module_inst);
+
+  // '_host_timer_arm' import, called from any of the instance's threads
+  static void arm(wasm_exec_env_t exec_env, uint32_t delay_us);
+};
+
+#endif // HOST_TIMER_LOOP_H
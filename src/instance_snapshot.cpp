@@ -0,0 +1,110 @@
+#include "instance_snapshot.h"
+
+#include <cstring>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t value_size(wasm_valkind_t kind)
+{
+  switch (kind) {
+  case WASM_I32:
+  case WASM_F32:
+    return 4;
+  case WASM_I64:
+  case WASM_F64:
+    return 8;
+  case WASM_V128:
+    return 16;
+  default:
+    // references do not carry over to another instance
+    return 0;
+  }
+}
+
+instance_snapshot::~instance_snapshot()
+{
+  if (_image) munmap(_image, _size);
+  if (_fd >= 0) close(_fd);
+}
+
+bool instance_snapshot::capture(wasm_module_t module,
+                                wasm_module_inst_t module_inst)
+{
+  if (_fd >= 0) return false;
+
+  auto memory = wasm_runtime_get_default_memory(module_inst);
+  if (!memory) return false;
+  _pages = (uint32_t)wasm_memory_get_cur_page_count(memory);
+  _size = (size_t)_pages * wasm_memory_get_bytes_per_page(memory);
+  auto base = static_cast<const uint8_t *>(wasm_memory_get_base_address(memory));
+
+  _fd = memfd_create("wasm snapshot", MFD_CLOEXEC);
+  if (_fd < 0) return false;
+  for (size_t done = 0; done < _size;) {
+    ssize_t n = pwrite(_fd, base + done, _size - done, done);
+    if (n <= 0) return false;
+    done += n;
+  }
+  _image = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+  if (_image == MAP_FAILED) {
+    _image = nullptr;
+    return false;
+  }
+
+  int32_t exports = wasm_runtime_get_export_count(module);
+  for (int32_t i = 0; i < exports; i++) {
+    wasm_export_t export_type;
+    wasm_runtime_get_export_type(module, i, &export_type);
+    if (export_type.kind != WASM_IMPORT_EXPORT_KIND_GLOBAL) continue;
+
+    wasm_global_inst_t global;
+    if (!wasm_runtime_get_export_global_inst(module_inst, export_type.name,
+                                             &global) ||
+        !global.is_mutable || !value_size(global.kind)) {
+      continue;
+    }
+    global_t saved = {export_type.name, global.kind, {0}};
+    memcpy(saved.value, global.global_data, value_size(global.kind));
+    _globals.push_back(saved);
+  }
+  return true;
+}
+
+bool instance_snapshot::restore(wasm_module_inst_t module_inst) const
+{
+  if (!_image) return false;
+
+  // the image holds whatever the memory grew to during init
+  auto memory = wasm_runtime_get_default_memory(module_inst);
+  if (!memory) return false;
+  uint32_t pages = (uint32_t)wasm_memory_get_cur_page_count(memory);
+  if (pages > _pages ||
+      (pages < _pages && !wasm_runtime_enlarge_memory(module_inst,
+                                                      _pages - pages))) {
+    return false;
+  }
+
+  // the base may only be looked up once the memory has grown
+  void *base = wasm_memory_get_base_address(memory);
+  long page_size = sysconf(_SC_PAGESIZE);
+  if ((uintptr_t)base % page_size == 0 && _size % page_size == 0) {
+    // replaces the pages in place, copy-on-write
+    void *mapped = mmap(base, _size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_FIXED, _fd, 0);
+    if (mapped == MAP_FAILED) return false;
+  } else {
+    memcpy(base, _image, _size);
+  }
+
+  for (const auto &saved : _globals) {
+    wasm_global_inst_t global;
+    if (!wasm_runtime_get_export_global_inst(module_inst, saved.name.c_str(),
+                                             &global) ||
+        global.kind != saved.kind) {
+      return false;
+    }
+    memcpy(global.global_data, saved.value, value_size(saved.kind));
+  }
+  return true;
+}
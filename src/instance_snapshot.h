@@ -0,0 +1,50 @@
+#ifndef INSTANCE_SNAPSHOT_H
+#define INSTANCE_SNAPSHOT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "wasm_export.h"
+
+// Linear memory and exported mutable globals of an initialized instance,
+// restored into new instances of the same module instead of repeating the
+// calls that initialized it.
+//
+// Only what lives in linear memory is captured: take the snapshot before
+// the module starts any thread. The image is kept in a memfd and mapped
+// copy-on-write into the instances restored from it, so they share the
+// pages none of them writes to.
+class instance_snapshot {
+  int _fd = -1;
+  // read-only view of the image, for instances it cannot be mapped into
+  void *_image = nullptr;
+  size_t _size = 0;
+  uint32_t _pages = 0;
+
+  struct global_t {
+    std::string name;
+    wasm_valkind_t kind;
+    uint8_t value[16];
+  };
+  std::vector<global_t> _globals;
+
+public:
+  instance_snapshot() = default;
+  ~instance_snapshot();
+
+  instance_snapshot(const instance_snapshot&) = delete;
+  void operator=(const instance_snapshot&) = delete;
+
+  // No module code may run on 'module_inst' meanwhile.
+  bool capture(wasm_module_t module, wasm_module_inst_t module_inst);
+
+  // Into a fresh instance of the same module, before any call.
+  bool restore(wasm_module_inst_t module_inst) const;
+
+  size_t size() const { return _size; }
+  uint32_t memory_pages() const { return _pages; }
+};
+
+#endif // INSTANCE_SNAPSHOT_H
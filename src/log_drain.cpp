@@ -0,0 +1,353 @@
+#include "log_drain.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// decoded binary record argument
+struct log_arg {
+  char tag;
+  uint64_t value;
+  double dvalue;
+  std::string str;
+
+  int64_t as_int() const {
+    switch (tag) {
+    case LOG_ARG_I32: return (int32_t)value;
+    case LOG_ARG_DOUBLE: return (int64_t)dvalue;
+    default: return (int64_t)value;
+    }
+  }
+
+  uint64_t as_uint() const {
+    return tag == LOG_ARG_DOUBLE ? (uint64_t)dvalue : value;
+  }
+
+  double as_double() const {
+    return tag == LOG_ARG_DOUBLE ? dvalue : (double)as_int();
+  }
+};
+
+class log_args_reader {
+  const char *_p;
+  const char *_end;
+
+  bool take(void *out, size_t size) {
+    if ((size_t)(_end - _p) < size) return false;
+    memcpy(out, _p, size);
+    _p += size;
+    return true;
+  }
+
+public:
+  log_args_reader(const char *data, size_t len) : _p(data), _end(data + len) {}
+
+  bool next(log_arg &arg) {
+    if (_p >= _end) return false;
+    arg.tag = *_p++;
+    arg.value = 0;
+    arg.dvalue = 0;
+
+    switch (arg.tag) {
+    case LOG_ARG_I32:
+    case LOG_ARG_PTR: {
+      uint32_t v;
+      if (!take(&v, sizeof(v))) return false;
+      arg.value = v;
+      return true;
+    }
+    case LOG_ARG_I64:
+      return take(&arg.value, sizeof(arg.value));
+    case LOG_ARG_DOUBLE:
+      return take(&arg.dvalue, sizeof(arg.dvalue));
+    case LOG_ARG_STR: {
+      uint16_t n;
+      if (!take(&n, sizeof(n)) || (size_t)(_end - _p) < n) return false;
+      arg.str.assign(_p, n);
+      _p += n;
+      return true;
+    }
+    default:
+      return false;
+    }
+  }
+};
+
+} // namespace
+
+bool parse_log_level(const std::string &name, module_log_level_t &level)
+{
+  static const char *const names[] = {"error", "warn", "info", "debug"};
+  for (unsigned i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    if (name == names[i] || name == std::to_string(i)) {
+      level = (module_log_level_t)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+// The one thread printing every started log_drain's records, in one write
+// per interval. Started with the first log_drain, stopped with the last.
+class log_sink {
+  std::mutex _mutex;
+  // held by the sink while reading, so that no drain leaves meanwhile
+  std::mutex _read_mutex;
+  std::vector<log_drain *> _drains;
+  std::unique_ptr<std::thread> _thread;
+  bool _running = false;
+  // of the current thread: a stopped one may still be on its way out
+  unsigned _generation = 0;
+
+  void run(unsigned generation);
+
+public:
+  static log_sink &instance() {
+    static log_sink sink;
+    return sink;
+  }
+
+  void add(log_drain *drain);
+  void remove(log_drain *drain);
+};
+
+void log_sink::add(log_drain *drain)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _drains.push_back(drain);
+  if (!_running) {
+    _running = true;
+    unsigned generation = ++_generation;
+    _thread = std::make_unique<std::thread>(
+        [this, generation]() { run(generation); });
+  }
+}
+
+void log_sink::remove(log_drain *drain)
+{
+  std::unique_ptr<std::thread> thread;
+  {
+    std::lock_guard<std::mutex> read_lock(_read_mutex);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _drains.erase(std::remove(_drains.begin(), _drains.end(), drain),
+                  _drains.end());
+    if (_drains.empty() && _running) {
+      _running = false;
+      thread = std::move(_thread);
+    }
+  }
+  if (thread) thread->join();
+}
+
+void log_sink::run(unsigned generation)
+{
+  std::vector<log_drain *> drains;
+  std::string batch;
+  while (true) {
+    {
+      std::lock_guard<std::mutex> read_lock(_read_mutex);
+      {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (!_running || _generation != generation) return;
+        drains = _drains;
+      }
+      for (auto drain : drains) drain->read(batch);
+    }
+
+    if (!batch.empty()) {
+      fwrite(batch.data(), 1, batch.size(), stdout);
+      fflush(stdout);
+      batch.clear();
+    }
+    std::this_thread::sleep_for(log_drain::interval);
+  }
+}
+
+constexpr std::chrono::milliseconds log_drain::interval;
+
+log_drain::log_drain(log_ring_t *ring, const char *mem, uint64_t mem_size,
+                     std::chrono::steady_clock::time_point epoch,
+                     const std::string &source)
+    : _ring(ring), _mem(mem), _mem_size(mem_size), _epoch(epoch),
+      _prefix(source.empty() ? "WASM" : "WASM " + source) {}
+
+log_drain::~log_drain() {
+  stop();
+}
+
+void log_drain::set_level(module_log_level_t level)
+{
+  __atomic_store_n(&_ring->level, (uint32_t)level, __ATOMIC_RELAXED);
+}
+
+void log_drain::start()
+{
+  if (_running.exchange(true)) return;
+  log_sink::instance().add(this);
+}
+
+void log_drain::stop()
+{
+  if (_running.exchange(false)) {
+    log_sink::instance().remove(this);
+  }
+  drain();
+}
+
+// Walks the printf format, formatting each conversion on its own with the
+// next argument converted to what the conversion expects.
+void log_drain::format(const log_record_t &rec, std::string &out) const
+{
+  uint32_t len = rec.len < LOG_RECORD_TEXT ? rec.len : LOG_RECORD_TEXT;
+  if (!rec.fmt) {
+    out.append(rec.text, len);
+    return;
+  }
+
+  const char *fmt = nullptr;
+  if (rec.fmt < _mem_size) {
+    fmt = _mem + rec.fmt;
+    if (!memchr(fmt, 0, _mem_size - rec.fmt)) fmt = nullptr;
+  }
+  if (!fmt) {
+    out += "<invalid format string>";
+    return;
+  }
+
+  log_args_reader args(rec.text, len);
+  log_arg arg;
+  char buf[256];
+
+  const char *p = fmt;
+  while (*p) {
+    if (*p != '%') {
+      out += *p++;
+      continue;
+    }
+    if (p[1] == '%') {
+      out += '%';
+      p += 2;
+      continue;
+    }
+
+    // flags, width and precision are kept; '*' takes an argument
+    std::string spec(1, *p++);
+    while (*p && (strchr("-+ #0.", *p) || isdigit((unsigned char)*p) ||
+                  *p == '*')) {
+      if (*p == '*') {
+        spec += args.next(arg) ? std::to_string(arg.as_int()) : "0";
+      } else {
+        spec += *p;
+      }
+      p++;
+    }
+    // length modifiers are replaced by the widest type of each kind
+    while (*p && strchr("hlLqjzt", *p)) p++;
+
+    char conv = *p;
+    if (!conv) break;
+    p++;
+
+    if (!args.next(arg)) {
+      out += "<?>";
+      continue;
+    }
+
+    int n = 0;
+    switch (conv) {
+    case 'd':
+    case 'i':
+      n = snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(),
+                   (long long)arg.as_int());
+      break;
+    case 'u':
+    case 'o':
+    case 'x':
+    case 'X':
+      n = snprintf(buf, sizeof(buf), (spec + "ll" + conv).c_str(),
+                   (unsigned long long)(arg.tag == LOG_ARG_I32
+                                            ? (uint32_t)arg.value
+                                            : arg.as_uint()));
+      break;
+    case 'c':
+      n = snprintf(buf, sizeof(buf), (spec + conv).c_str(), (int)arg.as_int());
+      break;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+    case 'a':
+    case 'A':
+      n = snprintf(buf, sizeof(buf), (spec + conv).c_str(), arg.as_double());
+      break;
+    case 's':
+      if (arg.tag == LOG_ARG_STR) {
+        n = snprintf(buf, sizeof(buf), (spec + 's').c_str(), arg.str.c_str());
+      } else {
+        n = snprintf(buf, sizeof(buf), "<?>");
+      }
+      break;
+    case 'p':
+      n = snprintf(buf, sizeof(buf), "0x%llx", (unsigned long long)arg.value);
+      break;
+    default:
+      n = snprintf(buf, sizeof(buf), "<%%%c?>", conv);
+      break;
+    }
+    out.append(buf, n < 0 ? 0 : n < (int)sizeof(buf) ? n : sizeof(buf) - 1);
+  }
+}
+
+size_t log_drain::drain()
+{
+  std::string batch;
+  size_t n = read(batch);
+  if (!batch.empty()) {
+    fwrite(batch.data(), 1, batch.size(), stdout);
+    fflush(stdout);
+  }
+  return n;
+}
+
+size_t log_drain::read(std::string &batch)
+{
+  static const char *const prefixes[] = {"error: ", "warning: ", "", ""};
+
+  log_record_t rec;
+  size_t n = 0;
+  while (log_ring_read(*_ring, rec)) {
+    uint64_t time_us = ((uint64_t)rec.time_us_hi << 32) | rec.time_us_lo;
+    auto logged = std::chrono::steady_clock::time_point(
+        std::chrono::microseconds(time_us));
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        logged - _epoch);
+
+    char prefix[48];
+    snprintf(prefix, sizeof(prefix), ": [%6ldms] %s", (long)ms.count(),
+             rec.level <= LOG_LEVEL_DEBUG ? prefixes[rec.level] : "");
+    batch += _prefix;
+    batch += prefix;
+    format(rec, batch);
+    batch += '\n';
+    n++;
+  }
+
+  uint32_t dropped = __atomic_load_n(&_ring->dropped, __ATOMIC_RELAXED);
+  if (dropped != _dropped) {
+    char line[64];
+    snprintf(line, sizeof(line), ": %u log records dropped\n",
+             dropped - _dropped);
+    batch += _prefix;
+    batch += line;
+    _dropped = dropped;
+  }
+  return n;
+}
@@ -0,0 +1,65 @@
+#ifndef LOG_DRAIN_H
+#define LOG_DRAIN_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+
+// shared with the WASM module
+#include "log_ring.h"
+
+// Prints the records of a module's log ring from a host thread, one write
+// per batch, so that logging never blocks module threads on host I/O. One
+// thread, the log sink, drains the rings of every started log_drain.
+//
+// Binary records are only formatted here, from the format string found in
+// the module's memory. The ring lives in the module's (shared, hence
+// non-moving) linear memory.
+class log_drain {
+  log_ring_t *_ring;
+  // module memory, for format strings
+  const char *_mem;
+  uint64_t _mem_size;
+  std::chrono::steady_clock::time_point _epoch;
+  // starts every line: "WASM", or "WASM <source>"
+  std::string _prefix;
+  uint32_t _dropped = 0;
+
+  std::atomic<bool> _running = {false};
+
+  friend class log_sink;
+  // Appends the new records to 'batch'; returns how many there were.
+  size_t read(std::string &batch);
+  void format(const log_record_t &rec, std::string &out) const;
+
+public:
+  static constexpr std::chrono::milliseconds interval{10};
+
+  // timestamps are printed in ms since 'epoch'; 'source' tells modules
+  // apart when several share the output
+  log_drain(log_ring_t *ring, const char *mem, uint64_t mem_size,
+            std::chrono::steady_clock::time_point epoch,
+            const std::string &source = std::string());
+  ~log_drain();
+
+  log_drain(const log_drain&) = delete;
+  void operator=(const log_drain&) = delete;
+
+  // Records more verbose than 'level' are dropped by the module itself.
+  void set_level(module_log_level_t level);
+
+  // Hands the ring to the log sink.
+  void start();
+
+  // Takes the ring back from the log sink, then prints what is left.
+  void stop();
+
+  // Returns the number of records printed.
+  size_t drain();
+};
+
+// "error", "warn", "info", "debug" or a number
+bool parse_log_level(const std::string &name, module_log_level_t &level);
+
+#endif // LOG_DRAIN_H
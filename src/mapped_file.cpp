@@ -0,0 +1,56 @@
+#include "mapped_file.h"
+
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(mapped_file &&other) noexcept
+    : _data(other._data), _size(other._size)
+{
+  other._data = nullptr;
+  other._size = 0;
+}
+
+mapped_file &mapped_file::operator=(mapped_file &&other) noexcept
+{
+  std::swap(_data, other._data);
+  std::swap(_size, other._size);
+  return *this;
+}
+
+bool mapped_file::map(const std::string &path)
+{
+  unmap();
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                    fd, 0);
+  // the mapping holds its own reference to the file
+  close(fd);
+  if (data == MAP_FAILED) return false;
+
+  // read through once by the loader
+  madvise(data, st.st_size, MADV_WILLNEED);
+
+  _data = static_cast<uint8_t *>(data);
+  _size = st.st_size;
+  return true;
+}
+
+void mapped_file::unmap()
+{
+  if (_data) munmap(_data, _size);
+  _data = nullptr;
+  _size = 0;
+}
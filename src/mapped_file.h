@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// File contents mapped copy-on-write rather than read into a buffer.
+//
+// wasm_runtime_load() may write to its input and keeps referencing it
+// until the module is unloaded: a private writable mapping allows both,
+// while the pages it leaves untouched (most of an AOT image) stay shared
+// with the page cache and with every other process mapping the file.
+class mapped_file {
+  uint8_t *_data = nullptr;
+  size_t _size = 0;
+
+public:
+  mapped_file() = default;
+  ~mapped_file() { unmap(); }
+
+  mapped_file(mapped_file &&other) noexcept;
+  mapped_file &operator=(mapped_file &&other) noexcept;
+
+  mapped_file(const mapped_file&) = delete;
+  void operator=(const mapped_file&) = delete;
+
+  // Replaces the current mapping; fails on empty files.
+  bool map(const std::string &path);
+  void unmap();
+
+  uint8_t *data() const { return _data; }
+  size_t size() const { return _size; }
+  bool empty() const { return !_data; }
+};
+
+#endif // MAPPED_FILE_H
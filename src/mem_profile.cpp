@@ -0,0 +1,143 @@
+#include "mem_profile.h"
+#include "wamr_output.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+static uint32_t round_up(uint32_t value, uint32_t align) {
+  return (value + align - 1) / align * align;
+}
+
+static uint32_t with_headroom(uint32_t value) {
+  return value + std::max<uint32_t>(value / 4, 1);
+}
+
+void mem_profile::merge(const mem_profile &other)
+{
+  memory_pages_initial = std::max(memory_pages_initial, other.memory_pages_initial);
+  memory_pages_peak = std::max(memory_pages_peak, other.memory_pages_peak);
+  heap_peak = std::max(heap_peak, other.heap_peak);
+  interp_stack_peak = std::max(interp_stack_peak, other.interp_stack_peak);
+  app_heap_peak = std::max(app_heap_peak, other.app_heap_peak);
+  module_malloc |= other.module_malloc;
+
+  if (stacks.size() < other.stacks.size()) stacks.resize(other.stacks.size());
+  for (size_t i = 0; i < other.stacks.size(); i++) {
+    stacks[i].peak = std::max(stacks[i].peak, other.stacks[i].peak);
+    stacks[i].size = std::max(stacks[i].size, other.stacks[i].size);
+  }
+}
+
+bool mem_profile::save(const std::string &path) const
+{
+  std::ofstream out(path, std::ios::trunc);
+  out << "memory_pages_initial " << memory_pages_initial << "\n"
+      << "memory_pages_peak " << memory_pages_peak << "\n"
+      << "heap_peak " << heap_peak << "\n"
+      << "interp_stack_peak " << interp_stack_peak << "\n"
+      << "app_heap_peak " << app_heap_peak << "\n"
+      << "module_malloc " << (module_malloc ? 1 : 0) << "\n";
+  for (auto &stack : stacks) {
+    out << "stack " << stack.peak << " " << stack.size << "\n";
+  }
+  return (bool)out;
+}
+
+bool mem_profile::load(const std::string &path)
+{
+  std::ifstream in(path);
+  if (!in.is_open()) return false;
+
+  *this = mem_profile();
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    std::string key;
+    fields >> key;
+    if (key == "memory_pages_initial") fields >> memory_pages_initial;
+    else if (key == "memory_pages_peak") fields >> memory_pages_peak;
+    else if (key == "heap_peak") fields >> heap_peak;
+    else if (key == "interp_stack_peak") fields >> interp_stack_peak;
+    else if (key == "app_heap_peak") fields >> app_heap_peak;
+    else if (key == "module_malloc") fields >> module_malloc;
+    else if (key == "stack") {
+      stack_t stack = {0, 0};
+      fields >> stack.peak >> stack.size;
+      stacks.push_back(stack);
+    }
+  }
+  return true;
+}
+
+instance_sizes derive_sizes(const mem_profile &profile, instance_sizes sizes)
+{
+  if (profile.interp_stack_peak) {
+    sizes.stack_size = round_up(with_headroom(profile.interp_stack_peak), 4096);
+  }
+  if (profile.module_malloc) {
+    sizes.heap_size = 0;
+  } else if (profile.app_heap_peak) {
+    sizes.heap_size = round_up(with_headroom(profile.app_heap_peak), 4096);
+  }
+  if (profile.memory_pages_peak) {
+    sizes.max_memory_pages = with_headroom(profile.memory_pages_peak);
+  }
+  // the main stack is not a module thread's
+  uint32_t thread_stack_peak = 0;
+  for (size_t i = 1; i < profile.stacks.size(); i++) {
+    thread_stack_peak = std::max(thread_stack_peak, profile.stacks[i].peak);
+  }
+  if (thread_stack_peak) {
+    sizes.thread_stack_size = round_up(with_headroom(thread_stack_peak), 4096);
+  }
+  return sizes;
+}
+
+#if defined(WAMR_MEMORY_PROFILING)
+
+bool wamr_mem_consumption(wasm_exec_env_t exec_env, mem_profile &profile)
+{
+  std::istringstream lines(capture_wamr_output(
+      [&]() { wasm_runtime_dump_mem_consumption(exec_env); }));
+  std::string line;
+  bool found = false;
+  while (std::getline(lines, line)) {
+    unsigned value;
+    if (sscanf(line.c_str(), "Total interpreter stack used: %u", &value) == 1) {
+      profile.interp_stack_peak = value;
+      found = true;
+    } else if (sscanf(line.c_str(), "Total app heap used: %u", &value) == 1) {
+      profile.app_heap_peak = value;
+    }
+  }
+  return found;
+}
+
+#else
+
+bool wamr_mem_consumption(wasm_exec_env_t, mem_profile &)
+{
+  return false;
+}
+
+#endif
+
+bool read_process_rss(uint64_t &rss_kb, uint64_t &peak_kb)
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  int found = 0;
+  while (std::getline(status, line) && found < 2) {
+    // "VmRSS:     1234 kB"
+    if (line.compare(0, 6, "VmRSS:") == 0) {
+      rss_kb = std::stoull(line.substr(6));
+      found++;
+    } else if (line.compare(0, 6, "VmHWM:") == 0) {
+      peak_kb = std::stoull(line.substr(6));
+      found++;
+    }
+  }
+  return found == 2;
+}
@@ -0,0 +1,57 @@
+#ifndef MEM_PROFILE_H
+#define MEM_PROFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "wasm_export.h"
+
+// Memory used by a run, written by --mem-profile and read back by
+// --mem-sizes to size instances. Zero means unknown.
+struct mem_profile {
+  uint32_t memory_pages_initial = 0;
+  uint32_t memory_pages_peak = 0;
+  // module malloc arena
+  uint32_t heap_peak = 0;
+  // WAMR, for the main exec env (WAMR_MEMORY_PROFILING builds)
+  uint32_t interp_stack_peak = 0;
+  uint32_t app_heap_peak = 0;
+  // WAMR ignores the host-managed heap of modules exporting malloc/free
+  bool module_malloc = false;
+
+  // module threads, the main stack first
+  struct stack_t {
+    uint32_t peak;
+    uint32_t size;
+  };
+  std::vector<stack_t> stacks;
+
+  // Keeps the larger of each figure, e.g. across instances.
+  void merge(const mem_profile &other);
+
+  bool save(const std::string &path) const;
+  bool load(const std::string &path);
+};
+
+struct instance_sizes {
+  uint32_t stack_size = 64 * 1024;
+  uint32_t heap_size = 64 * 1024;
+  // 0: the module's own maximum
+  uint32_t max_memory_pages = 0;
+  // pthread stacks of module threads, 0: the module's default
+  uint32_t thread_stack_size = 0;
+};
+
+// Sizes covering 'profile' with 25% headroom; figures the profile does not
+// know keep their value from 'sizes'.
+instance_sizes derive_sizes(const mem_profile &profile, instance_sizes sizes);
+
+// Reads WAMR's memory consumption report for 'exec_env'; false unless WAMR
+// was built with memory profiling.
+bool wamr_mem_consumption(wasm_exec_env_t exec_env, mem_profile &profile);
+
+// Resident set size of this process and its peak, in KB
+bool read_process_rss(uint64_t &rss_kb, uint64_t &peak_kb);
+
+#endif // MEM_PROFILE_H
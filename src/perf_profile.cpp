@@ -0,0 +1,69 @@
+#include "perf_profile.h"
+#include "wamr_output.h"
+
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+bool perf_profile::collect(wasm_module_inst_t module_inst)
+{
+  std::istringstream lines(capture_wamr_output(
+      [&]() { wasm_runtime_dump_perf_profiling(module_inst); }));
+
+  bool found = false;
+  std::string line;
+  while (std::getline(lines, line)) {
+    // "  func <name or index>, execution time: 1.234 ms, execution count:
+    // 5 times, children execution time: 0.123 ms"
+    size_t name_pos = line.find("func ");
+    size_t stats_pos = line.find(", execution time:");
+    if (name_pos == std::string::npos || stats_pos == std::string::npos) {
+      continue;
+    }
+    name_pos += 5;
+
+    func_t func;
+    unsigned calls = 0;
+    int fields = sscanf(line.c_str() + stats_pos,
+                        ", execution time: %lf ms, execution count: %u times, "
+                        "children execution time: %lf ms",
+                        &func.total_ms, &calls, &func.children_ms);
+    if (fields < 2 || !calls) continue;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    func_t &total = _funcs[line.substr(name_pos, stats_pos - name_pos)];
+    total.calls += calls;
+    total.total_ms += func.total_ms;
+    total.children_ms += func.children_ms;
+    found = true;
+  }
+  return found;
+}
+
+bool perf_profile::empty() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _funcs.empty();
+}
+
+void perf_profile::print(FILE *out) const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  typedef std::pair<std::string, func_t> entry_t;
+  std::vector<entry_t> funcs(_funcs.begin(), _funcs.end());
+  auto self_ms = [](const func_t &f) { return f.total_ms - f.children_ms; };
+  std::sort(funcs.begin(), funcs.end(),
+            [&](const entry_t &a, const entry_t &b) {
+              return self_ms(a.second) > self_ms(b.second);
+            });
+
+  fprintf(out, "%-32s %10s %12s %12s %12s\n", "wasm function", "calls",
+          "self (ms)", "total (ms)", "per call (us)");
+  for (const auto &f : funcs) {
+    fprintf(out, "%-32s %10llu %12.3f %12.3f %12.3f\n", f.first.c_str(),
+            (unsigned long long)f.second.calls, self_ms(f.second),
+            f.second.total_ms, 1000.0 * f.second.total_ms / f.second.calls);
+  }
+  fflush(out);
+}
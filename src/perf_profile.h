@@ -0,0 +1,47 @@
+#ifndef PERF_PROFILE_H
+#define PERF_PROFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "wasm_export.h"
+
+// Execution time per wasm function, from WAMR's perf profiler
+// (WAMR_PERF_PROFILING builds). Each wasi thread runs its own module
+// instance with its own counters: collect() every one of them, the
+// module threads' before they exit.
+class perf_profile {
+public:
+  struct func_t {
+    uint64_t calls = 0;
+    // including the functions it called
+    double total_ms = 0;
+    double children_ms = 0;
+  };
+
+private:
+  mutable std::mutex _mutex;
+  std::map<std::string, func_t> _funcs;
+
+public:
+  // Adds the counters of 'module_inst'; false if WAMR reported none.
+  bool collect(wasm_module_inst_t module_inst);
+
+  bool empty() const;
+
+  // By self time, the most expensive first
+  void print(FILE *out) const;
+};
+
+// CPU time of the calling thread
+inline uint64_t thread_cpu_ns() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+#endif // PERF_PROFILE_H
@@ -0,0 +1,46 @@
+#include "wamr_output.h"
+
+#include <cstdarg>
+#include <cstdio>
+
+#if defined(WAMR_CAPTURE_OUTPUT)
+
+// WAMR's os_printf() output while a report is being captured
+static thread_local std::string *_capture = nullptr;
+
+// BH_VPRINTF hook, see CMakeLists.txt
+extern "C" int wamr_vprintf(const char *format, va_list ap)
+{
+  if (!_capture) return vprintf(format, ap);
+
+  // profiling lines carry long function names: size the line first
+  va_list copy;
+  va_copy(copy, ap);
+  int len = vsnprintf(nullptr, 0, format, copy);
+  va_end(copy);
+  if (len <= 0) return len;
+
+  size_t offset = _capture->size();
+  _capture->resize(offset + len + 1);
+  vsnprintf(&(*_capture)[offset], len + 1, format, ap);
+  _capture->resize(offset + len);
+  return len;
+}
+
+std::string capture_wamr_output(const std::function<void()> &dump)
+{
+  std::string output;
+  _capture = &output;
+  dump();
+  _capture = nullptr;
+  return output;
+}
+
+#else
+
+std::string capture_wamr_output(const std::function<void()> &)
+{
+  return std::string();
+}
+
+#endif
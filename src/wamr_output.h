@@ -0,0 +1,13 @@
+#ifndef WAMR_OUTPUT_H
+#define WAMR_OUTPUT_H
+
+#include <functional>
+#include <string>
+
+// Runs 'dump', a wasm_runtime_dump_*() call, and returns what WAMR printed
+// meanwhile on this thread. Returns an empty string without running it
+// unless WAMR prints through the wamr_vprintf hook (WAMR_MEMORY_PROFILING
+// or WAMR_PERF_PROFILING builds).
+std::string capture_wamr_output(const std::function<void()> &dump);
+
+#endif // WAMR_OUTPUT_H
@@ -1,74 +1,328 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
 #include <chrono>
+#include <condition_variable>
+#include <cstdlib>
 #include <cstring>
-#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include <unistd.h>
+
 using namespace std::chrono_literals;
 
 // WAMR headers
 #include "wasm_export.h"
 #include "wasm_c_api.h"
 
+// shared with the WASM module
+#include "counter_region.h"
+#include "mem_usage.h"
+#include "timer_stats.h"
 
-class WAMRRunner {
-private:
+#include "aot_cache.h"
+#include "host_timer_loop.h"
+#include "instance_snapshot.h"
+#include "log_drain.h"
+#include "mem_profile.h"
+#include "perf_profile.h"
+#include "wasm_fn.h"
 
-  static const std::invalid_argument function_is_null;
-  
-  std::shared_ptr<void> wamr_init;
-  std::vector<uint8_t> binary;
-  std::shared_ptr<WASMModuleCommon> module;
-  std::shared_ptr<WASMModuleInstanceCommon> module_inst;
-  std::shared_ptr<WASMExecEnv> exec_env;
+// time base of every log line
+static const auto _start_time = std::chrono::steady_clock::now();
 
-  wasm_function_inst_t get_module_name_func = nullptr;
-  wasm_function_inst_t get_counters_func = nullptr;
-  wasm_function_inst_t create_timers_func = nullptr;
-  wasm_function_inst_t start_timers_func = nullptr;
-  wasm_function_inst_t stop_timers_func = nullptr;
-  wasm_function_inst_t cleanup_func = nullptr;
-  wasm_function_inst_t async_cleanup_func = nullptr;
 
-  inline void throw_wasm_exception() {
-    throw std::runtime_error(wasm_runtime_get_exception(module_inst.get()));
+// The process-wide WAMR runtime and host natives, shared by every module
+// loaded in the process; destroyed with the last of them.
+class WAMRRuntime {
+  bool initialized = false;
+
+public:
+  WAMRRuntime() = default;
+  WAMRRuntime(const WAMRRuntime&) = delete;
+  void operator=(const WAMRRuntime&) = delete;
+  ~WAMRRuntime() {
+    if (initialized) wasm_runtime_destroy();
   }
 
-  inline void ensure_func(wasm_function_inst_t func) {
-    if (!func) throw std::invalid_argument("function is null");
+  // 'max_threads': module threads per instance, 0 for WAMR's default;
+  // 'linux_perf': write a perf map of AOT code (WAMR_PERF_PROFILING builds)
+  bool initialize(NativeSymbol* native_symbols, unsigned n_native_symbols,
+                  uint32_t max_threads = 0, bool linux_perf = false) {
+
+    RuntimeInitArgs init_args;
+    memset(&init_args, 0, sizeof(init_args));
+    init_args.mem_alloc_type = Alloc_With_System_Allocator;
+    init_args.max_thread_num = max_threads;
+    init_args.enable_linux_perf = linux_perf;
+    if (!wasm_runtime_full_init(&init_args)) {
+      std::cerr << "Failed to initialize WAMR" << std::endl;
+      return false;
+    }
+    initialized = true;
+    wasm_runtime_set_log_level(WASM_LOG_LEVEL_WARNING);
+
+    bool ret = true;
+    if (native_symbols && n_native_symbols > 0) {
+      ret = wasm_runtime_register_natives("env", native_symbols, n_native_symbols);
+    }
+
+    return ret;
   }
 
-  template<typename ...Args>
-  inline bool check_call_no_except(wasm_function_inst_t func, Args&& ...args) {
-    ensure_func(func);
-    return wasm_runtime_call_wasm(exec_env.get(), func, args...);
+  bool is_initialized() const { return initialized; }
+};
+
+
+// A loaded module, shared by all of its instances: the file is mapped,
+// parsed and validated (or its AOT image relocated) only once.
+class WAMRModule {
+  std::shared_ptr<WAMRRuntime> runtime;
+  // tags the module's log lines, if set
+  std::string log_source;
+  // referenced by the loaded module
+  mapped_file binary;
+  std::shared_ptr<WASMModuleCommon> module;
+  // exported functions, as found at load time
+  std::set<std::string> func_exports;
+
+  // compiled modules preferred over the interpreter, if set
+  std::unique_ptr<aot_cache> aot;
+  std::string aot_key;
+
+  static void free_module(WASMModuleCommon* module) {
+    if (module) wasm_runtime_unload(module);
   }
 
-  template<typename ...Args>
-  inline bool check_call_a_no_except(wasm_function_inst_t func, Args&& ...args) {
-    ensure_func(func);
-    return wasm_runtime_call_wasm_a(exec_env.get(), func, args...);
+  // Whether the .aot next to the module was compiled from 'binary', for
+  // this CPU, according to the key the wasm_module_aot target wrote with it
+  bool aot_built_for_binary(const std::string &aot_file,
+                            const std::string &key) const {
+    std::string built_for = aot_cache::read_artifact_key(aot_file);
+    if (built_for.empty()) return false;
+    if (built_for == key ||
+        built_for == aot_cache::artifact_key(binary.data(), binary.size(), "")) {
+      return true;
+    }
+    std::cerr << "Ignoring " << aot_file << " (built from another module or "
+              << "for another CPU)" << std::endl;
+    return false;
   }
 
-  template<typename ...Args>
-  inline void check_call(Args&& ...args) {
-    if (!check_call_no_except(args...)) {
-      throw_wasm_exception();
+  // Compiled counterpart of 'binary', from the cache or else next to
+  // 'filename' (built by the wasm_module_aot target); null if there is none
+  // that loads. The AOT image replaces 'binary', which must outlive 'module'.
+  std::shared_ptr<WASMModuleCommon> load_aot(const std::string &filename) {
+    std::string key = aot_cache::key(binary.data(), binary.size());
+    mapped_file aot_binary;
+
+    bool cached = aot->load(key, aot_binary);
+    std::string aot_file = filename.substr(0, filename.rfind(".wasm")) + ".aot";
+    // never loaded, nor cached, without a matching key
+    if (!cached && !(aot_built_for_binary(aot_file, key) &&
+                     aot_binary.map(aot_file))) {
+      return nullptr;
+    }
+
+    char error_buf[128];
+    std::shared_ptr<WASMModuleCommon> aot_module = {
+        wasm_runtime_load(aot_binary.data(), aot_binary.size(), error_buf,
+                          sizeof(error_buf)),
+        free_module};
+    if (!aot_module) {
+      std::cerr << "Ignoring AOT module (" << error_buf << ")" << std::endl;
+      // e.g. built by another WAMR version
+      if (cached) aot->remove(key);
+      return nullptr;
     }
+
+    if (!cached && !aot->store(key, aot_file)) {
+      std::cerr << "Failed to cache AOT module in " << aot->dir() << std::endl;
+    }
+    binary = std::move(aot_binary);
+    aot_key = key;
+    return aot_module;
   }
 
-  template<typename ...Args>
-  inline void check_call_a(Args&& ...args) {
-    if (!check_call_a_no_except(args...)) {
-      throw_wasm_exception();
+public:
+
+  explicit WAMRModule(std::shared_ptr<WAMRRuntime> runtime,
+                      const std::string &log_source = std::string())
+      : runtime(std::move(runtime)), log_source(log_source) {}
+  WAMRModule(const WAMRModule&) = delete;
+  WAMRModule(WAMRModule&&) = delete;
+
+  // Before load(); empty 'dir' for the default cache location
+  void use_aot_cache(const std::string &dir) {
+    aot = std::make_unique<aot_cache>(dir);
+  }
+
+  bool load(const std::string &filename) {
+
+    if (!runtime || !runtime->is_initialized()) return false;
+
+    if (!binary.map(filename)) {
+      std::cerr << "Failed to read WASM file: " << filename << std::endl;
+      return false;
+    }
+
+    if (aot && get_package_type(binary.data(), binary.size()) ==
+                   Wasm_Module_Bytecode) {
+      module = load_aot(filename);
     }
+
+    // Load WASM module
+    char error_buf[128];
+    if (!module) {
+      module = {wasm_runtime_load(binary.data(), binary.size(), error_buf,
+                                  sizeof(error_buf)),
+                free_module};
+    }
+
+    if (!module) {
+      std::cerr << "Failed to load WASM module: " << error_buf << std::endl;
+      return false;
+    }
+
+    int32_t exports = wasm_runtime_get_export_count(module.get());
+    for (int32_t i = 0; i < exports; i++) {
+      wasm_export_t export_type;
+      wasm_runtime_get_export_type(module.get(), i, &export_type);
+      if (export_type.kind == WASM_IMPORT_EXPORT_KIND_FUNC) {
+        func_exports.insert(export_type.name);
+      }
+    }
+    return true;
   }
 
-  static void free_module(WASMModuleCommon* module) {
-    if (module) wasm_runtime_unload(module);
+  wasm_module_t get() const { return module.get(); }
+
+  const std::set<std::string> &exports() const { return func_exports; }
+
+  bool exports(const std::string &name) const {
+    return func_exports.count(name) > 0;
+  }
+
+  const std::string &get_log_source() const { return log_source; }
+
+  // Shared by the instances
+  size_t image_size() const { return binary.size(); }
+
+  // Empty when running on the interpreter
+  const std::string &aot_module_key() const { return aot_key; }
+};
+
+
+// An initialized instance, restored by WAMRRunner::instantiate() into new
+// instances of the same module
+struct runner_snapshot {
+  instance_snapshot image;
+  // the scratch block, allocated before the capture
+  uint32_t scratch_app = 0;
+  uint32_t scratch_size = 0;
+};
+
+class WAMRRunner {
+private:
+
+  std::shared_ptr<WAMRModule> module;
+  std::shared_ptr<WASMModuleInstanceCommon> module_inst;
+  std::shared_ptr<WASMExecEnv> exec_env;
+
+  typedef wasm_fn<void(uint32_t, uint32_t)> batch_fn;
+
+  wasm_fn<uint32_t()> get_module_name_func;
+  wasm_fn<void(uint32_t, uint32_t)> get_counters_func;
+  wasm_fn<void()> create_timers_func;
+  wasm_fn<void()> start_timers_func;
+  wasm_fn<void()> stop_timers_func;
+  wasm_fn<void()> cleanup_func;
+  wasm_fn<bool()> async_cleanup_func;
+  wasm_fn<void(uint32_t)> start_timer_workers_func;
+  wasm_fn<uint32_t(uint32_t, uint32_t, uint32_t, uint32_t)> create_timers_batch_func;
+  batch_fn destroy_timers_batch_func;
+  batch_fn start_timers_batch_func;
+  batch_fn stop_timers_batch_func;
+  wasm_fn<void(uint32_t, uint32_t, uint32_t)> set_timer_periods_batch_func;
+  wasm_fn<uint32_t()> get_timer_stats_func;
+
+  // module thread pool (thread_pool.h)
+  wasm_fn<void(uint32_t)> set_thread_stack_size_func;
+  wasm_fn<uint32_t(uint32_t)> prewarm_threads_func;
+
+  // --stress, bench_module.wasm only
+  wasm_fn<uint32_t(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t)>
+      stress_create_timers_func;
+  wasm_fn<void(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t)>
+      stress_start_producers_func;
+  wasm_fn<uint32_t()> stress_stop_producers_func;
+  wasm_fn<void()> stress_free_timers_func;
+
+  // WASI command modules
+  wasm_fn<void()> start_func;
+
+  // out-parameters and batches, instead of module mallocs per call
+  wasm_scratch scratch;
+
+  // counters read without entering the module, if exported
+  const counter_region_t *counter_region = nullptr;
+
+  // --mem-profile
+  wasm_fn<uint32_t()> get_mem_usage_func;
+  mem_profile profile;
+
+  // module timers driven by host_timer_loop (TIMER_DRIVER=host)
+  bool host_timers = false;
+
+  // module log ring reader, if exported
+  std::unique_ptr<log_drain> log;
+
+  // set through the '_host_queue_stopped' import
+  std::mutex queue_stop_mutex;
+  std::condition_variable queue_stop_cv;
+  bool queue_stopped = false;
+
+  // CPU time of the host threads driving the instance, and of the module
+  // threads that exited (reported through '_host_thread_exit')
+  std::atomic<uint64_t> host_cpu_ns = {0};
+  std::atomic<uint64_t> module_threads_cpu_ns = {0};
+
+  // finds the runner from any of the instance's threads
+  static void *context_key() {
+    static void *key = wasm_runtime_create_context_key(nullptr);
+    return key;
+  }
+
+  static WAMRRunner *from_exec_env(wasm_exec_env_t exec_env) {
+    return static_cast<WAMRRunner *>(wasm_runtime_get_context(
+        wasm_runtime_get_module_inst(exec_env), context_key()));
+  }
+
+  // Copies 'ids' to the scratch region, then 'values' right after them
+  void stage_batch(const std::vector<uint32_t> &ids,
+                   const std::vector<uint32_t> *values = nullptr) {
+    uint32_t size = ids.size() * sizeof(uint32_t);
+    scratch.reserve(module_inst.get(), values ? 2 * size : size);
+    memcpy(scratch.native(), ids.data(), size);
+    if (values) memcpy(scratch.native(size), values->data(), size);
+  }
+
+  void call_batch(const batch_fn &func, const std::vector<uint32_t> &ids) {
+    if (ids.empty()) return;
+
+    stage_batch(ids);
+    func(exec_env.get(), scratch.app(), (uint32_t)ids.size());
   }
 
   static void free_module_inst(WASMModuleInstanceCommon* module_inst) {
@@ -81,211 +335,1369 @@ private:
 
 public:
 
-  WAMRRunner() = default;
+  explicit WAMRRunner(std::shared_ptr<WAMRModule> module)
+      : module(std::move(module)) {}
+  ~WAMRRunner() {
+    log.reset();
+    if (host_timers) host_timer_loop::instance().detach(module_inst.get());
+  }
   WAMRRunner(const WAMRRunner&) = delete;
   WAMRRunner(WAMRRunner&&) = delete;
   
-  wasm_function_inst_t lookup_function(const char *func_name) {
-    return wasm_runtime_lookup_function(module_inst.get(), func_name);
+  // '_host_queue_stopped' import, from the module's timer thread (or from
+  // 'async_cleanup' with TIMER_DRIVER=host)
+  static void notify_queue_stopped(wasm_exec_env_t exec_env) {
+    auto runner = from_exec_env(exec_env);
+    if (!runner) return;
+
+    std::lock_guard<std::mutex> lock(runner->queue_stop_mutex);
+    runner->queue_stopped = true;
+    runner->queue_stop_cv.notify_all();
   }
 
-  bool initialize(NativeSymbol* native_symbols, unsigned n_native_symbols) {
+  // '_host_thread_exit' import, on the exiting module thread
+  static void notify_thread_exit(wasm_exec_env_t exec_env) {
+    if (auto runner = from_exec_env(exec_env)) {
+      runner->module_threads_cpu_ns += thread_cpu_ns();
+    }
+  }
 
-    wasm_runtime_init();
-    wamr_init = {(void*)1, [](void*){wasm_runtime_destroy();}};
-    wasm_runtime_set_log_level(WASM_LOG_LEVEL_WARNING);
+  // Module name tagging the instance's log lines, empty for none
+  static std::string log_source(wasm_exec_env_t exec_env) {
+    auto runner = from_exec_env(exec_env);
+    return runner ? runner->module->get_log_source() : std::string();
+  }
 
-    bool ret = true;
-    if (native_symbols && n_native_symbols > 0) {
-      ret = wasm_runtime_register_natives("env", native_symbols, n_native_symbols);
+  // How the instances of 'module' are run, from what it exports: the
+  // timer run of the sample module, a WASI command's _start, or nothing
+  // (instances are created, held for the run, and accounted for)
+  static const char *entry_point(const WAMRModule &module) {
+    if (module.exports("start_timers") && module.exports("stop_timers") &&
+        (module.exports("async_cleanup") || module.exports("cleanup"))) {
+      return "timer run";
     }
+    return module.exports("_start") ? "_start" : "none";
+  }
 
-    return ret;
+  wasm_function_inst_t lookup_function(const char *func_name) {
+    return wasm_runtime_lookup_function(module_inst.get(), func_name);
   }
 
-  bool loadWasmFile(const std::string &filename) {
+  // Creates the instance and its main exec env, and initializes the module
+  // (static timers, thread stack size) unless 'snapshot' restores it in
+  // that state. With 'capture', stores a snapshot of the initialized
+  // instance there (null on failure). The exec env is bound to the calling
+  // thread: every later call must come from it.
+  bool instantiate(const instance_sizes &sizes = instance_sizes(),
+                   const runner_snapshot *snapshot = nullptr,
+                   std::shared_ptr<const runner_snapshot> *capture = nullptr) {
 
-    if (!wamr_init) return false;
+    if (!module || !module->get()) return false;
 
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-      std::cerr << "Failed to open WASM file: " << filename << std::endl;
+    char error_buf[128];
+    InstantiationArgs args = {};
+    args.default_stack_size = sizes.stack_size;
+    args.host_managed_heap_size = sizes.heap_size;
+    args.max_memory_pages = sizes.max_memory_pages;
+    module_inst = {wasm_runtime_instantiate_ex(module->get(), &args, error_buf,
+                                               sizeof(error_buf)),
+                   free_module_inst};
+    if (!module_inst) {
+      std::cerr << "Failed to instantiate WASM module: " << error_buf
+                << std::endl;
       return false;
     }
 
-    std::streamsize file_size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    binary.resize(file_size);
+    // before any module thread: spawned instances inherit contexts
+    wasm_runtime_set_context_spread(module_inst.get(), context_key(), this);
 
-    if (!file.read((char*)binary.data(), binary.size())) {
-      std::cerr << "Failed to read WASM file" << std::endl;
+    exec_env = {wasm_runtime_create_exec_env(module_inst.get(),
+                                             sizes.stack_size),
+                wasm_runtime_destroy_exec_env};
+    if (!exec_env) {
+      std::cerr << "Failed to create execution environment" << std::endl;
       return false;
     }
 
-    // Load WASM module
-    char error_buf[128];
-    module = {wasm_runtime_load(binary.data(), binary.size(), error_buf,
-                                sizeof(error_buf)),
-              free_module};
-
-    if (!module) {
-      std::cerr << "Failed to load WASM module" << std::endl;
+    // before any call
+    if (snapshot && !snapshot->image.restore(module_inst.get())) {
+      std::cerr << "Failed to restore instance snapshot" << std::endl;
       return false;
     }
 
-    uint32_t stack_size = 64 * 1024;
-    uint32_t heap_size = 64 * 1024;
-    module_inst = {wasm_runtime_instantiate(module.get(), stack_size, heap_size,
-                                            error_buf, sizeof(error_buf)),
-                   free_module_inst};
-    if (!module_inst) {
-      std::cerr << "Failed to instantiate WASM module" << std::endl;
-      return false;
+    // each one optional: the run uses what the module exports
+    auto inst = module_inst.get();
+    get_module_name_func.bind(inst, "get_module_name");
+    get_counters_func.bind(inst, "get_counters");
+    create_timers_func.bind(inst, "create_timers");
+    start_timers_func.bind(inst, "start_timers");
+    stop_timers_func.bind(inst, "stop_timers");
+    cleanup_func.bind(inst, "cleanup");
+    async_cleanup_func.bind(inst, "async_cleanup");
+    start_timer_workers_func.bind(inst, "start_timer_workers");
+    create_timers_batch_func.bind(inst, "create_timers_batch");
+    destroy_timers_batch_func.bind(inst, "destroy_timers_batch");
+    start_timers_batch_func.bind(inst, "start_timers_batch");
+    stop_timers_batch_func.bind(inst, "stop_timers_batch");
+    set_timer_periods_batch_func.bind(inst, "set_timer_periods_batch");
+    get_timer_stats_func.bind(inst, "get_timer_stats");
+    set_thread_stack_size_func.bind(inst, "set_thread_stack_size");
+    prewarm_threads_func.bind(inst, "prewarm_threads");
+    stress_create_timers_func.bind(inst, "stress_create_timers");
+    stress_start_producers_func.bind(inst, "stress_start_producers");
+    stress_stop_producers_func.bind(inst, "stress_stop_producers");
+    stress_free_timers_func.bind(inst, "stress_free_timers");
+    start_func.bind(inst, "_start");
+
+    if (snapshot) {
+      scratch.adopt(inst, snapshot->scratch_app, snapshot->scratch_size);
+    } else if (has_timer_run()) {
+      // get_counters' out-parameters, and batches of up to 512 IDs
+      scratch.reserve(inst, 4096);
+      // starts no module thread: part of snapshots
+      if (create_timers_func) create_timers_func(exec_env.get());
+      if (sizes.thread_stack_size && set_thread_stack_size_func) {
+        set_thread_stack_size_func(exec_env.get(), sizes.thread_stack_size);
+      }
     }
+    resolve_counter_region();
 
-    exec_env = {wasm_runtime_create_exec_env(module_inst.get(), stack_size),
-                wasm_runtime_destroy_exec_env};
-    if (!exec_env) {
-      std::cerr << "Failed to create execution environment" << std::endl;
-      return false;
+    // before the log drain starts consuming the ring, which would leave
+    // restored instances with a stale head
+    if (capture) *capture = take_snapshot();
+
+    // before any call: the module arms host timers as soon as it starts one
+    host_timers = host_timer_loop::instance().attach(module_inst.get(),
+                                                     exec_env.get());
+    start_log_drain();
+    return true;
+  }
+
+  // Linear memory image of the instance, to instantiate others from.
+  // Only valid until the module starts a thread or the log drain starts:
+  // taken by instantiate() through 'capture'.
+  std::shared_ptr<const runner_snapshot> take_snapshot() {
+    auto snapshot = std::make_shared<runner_snapshot>();
+    if (!snapshot->image.capture(module->get(), module_inst.get())) {
+      return nullptr;
     }
+    snapshot->scratch_app = scratch.app();
+    snapshot->scratch_size = scratch.size();
+    return snapshot;
+  }
 
-    get_module_name_func = lookup_function("get_module_name");
-    get_counters_func = lookup_function("get_counters");
-    create_timers_func = lookup_function("create_timers");
-    start_timers_func = lookup_function("start_timers");
-    stop_timers_func = lookup_function("stop_timers");
-    cleanup_func = lookup_function("cleanup");
-    async_cleanup_func = lookup_function("async_cleanup");
+  // Execution times of the main instance's wasm functions, once the
+  // module threads are done
+  void collect_perf_profile(perf_profile &profile) {
+    profile.collect(module_inst.get());
+  }
 
-    if (!get_module_name_func || !get_counters_func || !create_timers_func ||
-        !start_timers_func || !stop_timers_func || !cleanup_func ||
-        !async_cleanup_func) {
-      std::cerr << "Failed to find one or more exported function(s)"
-                << std::endl;
-      return false;
+  // Spawns module threads until 'count' are parked; returns how many are.
+  uint32_t prewarm_threads(uint32_t count) {
+    if (!count || !prewarm_threads_func) return 0;
+    return prewarm_threads_func(exec_env.get(), count);
+  }
+
+  void resolve_counter_region() {
+    wasm_fn<uint32_t()> get_counter_region_func;
+    if (!get_counter_region_func.bind(module_inst.get(), "get_counter_region")) {
+      return;
+    }
+
+    uint32_t addr = get_counter_region_func(exec_env.get());
+    if (!wasm_runtime_validate_app_addr(module_inst.get(), addr,
+                                        sizeof(counter_region_t))) {
+      return;
+    }
+    counter_region = static_cast<const counter_region_t *>(
+        wasm_runtime_addr_app_to_native(module_inst.get(), addr));
+  }
+
+  uint32_t memory_pages() const {
+    auto memory = wasm_runtime_get_default_memory(module_inst.get());
+    return memory ? (uint32_t)wasm_memory_get_cur_page_count(memory) : 0;
+  }
+
+  // Linear memory never shrinks: this is also its peak
+  uint64_t memory_bytes() const {
+    auto memory = wasm_runtime_get_default_memory(module_inst.get());
+    return memory ? (uint64_t)wasm_memory_get_cur_page_count(memory) *
+                        wasm_memory_get_bytes_per_page(memory)
+                  : 0;
+  }
+
+  // By a host thread that drove the instance
+  void add_host_cpu(uint64_t ns) { host_cpu_ns += ns; }
+
+  // Host threads, exited module threads and host timer callbacks
+  uint64_t cpu_ns() {
+    uint64_t ns = host_cpu_ns + module_threads_cpu_ns;
+    if (host_timers) {
+      ns += host_timer_loop::instance().cpu_time_ns(module_inst.get());
     }
+    return ns;
+  }
 
+  void read_mem_usage() {
+    uint32_t addr = get_mem_usage_func(exec_env.get());
+    if (!wasm_runtime_validate_app_addr(module_inst.get(), addr,
+                                        sizeof(mem_usage_t))) {
+      return;
+    }
+    mem_usage_t usage;
+    memcpy(&usage, wasm_runtime_addr_app_to_native(module_inst.get(), addr),
+           sizeof(usage));
+
+    profile.heap_peak = usage.heap_end - usage.heap_base;
+    profile.stacks.clear();
+    uint32_t threads = std::min<uint32_t>(usage.threads, MEM_USAGE_THREADS);
+    for (uint32_t i = 0; i < threads; i++) {
+      profile.stacks.push_back({usage.thread[i].stack_peak,
+                                usage.thread[i].stack_size});
+    }
+  }
+
+  void start_log_drain() {
+    wasm_fn<uint32_t()> get_log_ring_func;
+    if (!get_log_ring_func.bind(module_inst.get(), "get_log_ring")) return;
+
+    uint32_t addr = get_log_ring_func(exec_env.get());
+    if (!wasm_runtime_validate_app_addr(module_inst.get(), addr,
+                                        sizeof(log_ring_t))) {
+      return;
+    }
+    auto ring = static_cast<log_ring_t *>(
+        wasm_runtime_addr_app_to_native(module_inst.get(), addr));
+    if (ring->records != LOG_RING_RECORDS) {
+      std::cerr << "Log ring size mismatch, module logs disabled" << std::endl;
+      return;
+    }
+
+    // format strings live in static data, present from instantiation on
+    uint64_t mem_start = 0, mem_end = 0;
+    wasm_runtime_get_app_addr_range(module_inst.get(), 0, &mem_start, &mem_end);
+    auto mem = static_cast<const char *>(
+        wasm_runtime_addr_app_to_native(module_inst.get(), 0));
+
+    log = std::make_unique<log_drain>(ring, mem, mem_end, _start_time,
+                                      module->get_log_source());
+    log->start();
+  }
+
+  void set_log_level(module_log_level_t level) {
+    if (log) log->set_level(level);
+  }
+
+  bool uses_host_timers() const { return host_timers; }
+
+  // Starts recording memory usage; module threads started from now on have
+  // their stack high-water mark tracked. False if the module cannot tell.
+  bool start_mem_profile() {
+    if (!get_mem_usage_func.bind(module_inst.get(), "get_mem_usage")) {
+      return false;
+    }
+    profile = mem_profile();
+    profile.module_malloc = lookup_function("malloc") && lookup_function("free");
+    profile.memory_pages_initial = profile.memory_pages_peak = memory_pages();
+    read_mem_usage();
     return true;
   }
 
+  // Linear memory growth, from any host thread
+  void sample_memory() {
+    profile.memory_pages_peak = std::max(profile.memory_pages_peak,
+                                         memory_pages());
+  }
+
+  // Once the module threads are done
+  const mem_profile &finish_mem_profile() {
+    sample_memory();
+    if (get_mem_usage_func) read_mem_usage();
+    wamr_mem_consumption(exec_env.get(), profile);
+    return profile;
+  }
+
   std::string get_module_name() {
-    wasm_val_t args[0];
-    wasm_val_t results[1] = { WASM_I32_VAL(0) };
-    check_call_a(get_module_name_func, 1, results, 0, args);
+    if (!get_module_name_func) return std::string();
+    uint32_t addr = get_module_name_func(exec_env.get());
 
-    const char* name = (const char*)wasm_runtime_addr_app_to_native(module_inst.get(), results[0].of.i32);
+    const char* name = (const char*)wasm_runtime_addr_app_to_native(module_inst.get(), addr);
     if (name) return std::string(name);
 
     return std::string();
   }
 
+  // Consistent snapshot of the counter region, taken with plain memory
+  // reads from any host thread. False if the module has no counter region,
+  // or if its writers kept racing with the reads.
+  bool snapshot_counters(std::vector<uint32_t> &counters) const {
+    if (!counter_region) return false;
+
+    uint32_t values[COUNTER_REGION_MAX];
+    int n = counter_region_read(*counter_region, values, COUNTER_REGION_MAX);
+    if (n < 0) return false;
+
+    counters.assign(values, values + n);
+    return true;
+  }
+
   void get_counters(std::vector<uint32_t> &counters) {
-    uint32_t* p_ptr = nullptr;
-    uint32_t* p_len = nullptr;
-    uint32_t wasm_ptr_addr = wasm_runtime_module_malloc(module_inst.get(), sizeof(uint32_t), (void**)&p_ptr);
-    uint32_t wasm_len_addr = wasm_runtime_module_malloc(module_inst.get(), sizeof(size_t), (void**)&p_len);
+    if (snapshot_counters(counters)) return;
+    counters.clear();
+    if (!get_counters_func) return;
+
+    // wasm32 'uint32_t*' and 'size_t' out-parameters
+    scratch.reserve(module_inst.get(), 2 * sizeof(uint32_t));
+    auto out = scratch.native<uint32_t>();
+    out[0] = out[1] = 0;
 
-    if (!wasm_ptr_addr || !wasm_len_addr) {
-      throw std::runtime_error("failed to allocate memory");
+    get_counters_func(exec_env.get(), scratch.app(), scratch.app(sizeof(uint32_t)));
+
+    out = scratch.native<uint32_t>();
+    uint32_t addr = out[0], len = out[1];
+    counters.resize(len);
+    if (!wasm_runtime_validate_app_addr(module_inst.get(), addr,
+                                        len * sizeof(uint32_t))) {
+      counters.clear();
+      return;
     }
+    memcpy(counters.data(), wasm_runtime_addr_app_to_native(module_inst.get(), addr),
+           len * sizeof(uint32_t));
+  }
 
-    *p_ptr = *p_len = 0;
+  bool get_timer_stats(timer_stats_t &stats) {
+    if (!get_timer_stats_func) return false;
 
-    uint32_t argv[2];
-    argv[0] = wasm_ptr_addr;
-    argv[1] = wasm_len_addr;
+    uint32_t addr = get_timer_stats_func(exec_env.get());
+    if (!wasm_runtime_validate_app_addr(module_inst.get(), addr, sizeof(stats))) {
+      return false;
+    }
+    memcpy(&stats, wasm_runtime_addr_app_to_native(module_inst.get(), addr),
+           sizeof(stats));
+    return true;
+  }
 
-    bool ok = check_call_no_except(get_counters_func, 2, argv);
-    if (ok) {
-      counters.resize(*p_len);
-      void* p_native = wasm_runtime_addr_app_to_native(module_inst.get(), *p_ptr);
-      if (p_native) {
-        memcpy(counters.data(), p_native, *p_len * sizeof(uint32_t));
-      }
+  // False if the module has no timer workers
+  bool start_timer_workers(uint32_t count) {
+    if (!start_timer_workers_func) return false;
+    start_timer_workers_func(exec_env.get(), count);
+    return true;
+  }
+
+  // Returns the IDs of the new timers: fewer than 'count' if the module's
+  // timer slab is full, none if it has no timer batches
+  std::vector<uint32_t> create_timers(uint32_t count, uint32_t period,
+                                      uint32_t slack) {
+    std::vector<uint32_t> ids;
+    if (!count || !create_timers_batch_func) return ids;
+
+    scratch.reserve(module_inst.get(), count * sizeof(uint32_t));
+    uint32_t created = create_timers_batch_func(exec_env.get(), scratch.app(),
+                                                count, period, slack);
+
+    auto first = scratch.native<const uint32_t>();
+    ids.assign(first, first + std::min(created, count));
+    return ids;
+  }
+
+  void destroy_timers(const std::vector<uint32_t> &ids) {
+    call_batch(destroy_timers_batch_func, ids);
+  }
+
+  // One host->wasm call and one timer command for the whole batch
+  void start_timers(const std::vector<uint32_t> &ids) {
+    call_batch(start_timers_batch_func, ids);
+  }
+
+  void stop_timers(const std::vector<uint32_t> &ids) {
+    call_batch(stop_timers_batch_func, ids);
+  }
+
+  void set_timer_periods(const std::vector<uint32_t> &ids,
+                         const std::vector<uint32_t> &periods) {
+    if (periods.size() != ids.size()) {
+      throw std::invalid_argument("periods / IDs size mismatch");
     }
+    if (ids.empty()) return;
 
-    wasm_runtime_module_free(module_inst.get(), wasm_ptr_addr);
-    wasm_runtime_module_free(module_inst.get(), wasm_len_addr);
+    stage_batch(ids, &periods);
+    set_timer_periods_batch_func(exec_env.get(), scratch.app(),
+                                 scratch.app(ids.size() * sizeof(uint32_t)),
+                                 (uint32_t)ids.size());
+  }
 
-    if (!ok) throw_wasm_exception();
+  // What start_timers() through shutdown() need
+  bool has_timer_run() const {
+    return start_timers_func && stop_timers_func &&
+           (async_cleanup_func || cleanup_func);
   }
 
-  void create_timers() { check_call(create_timers_func, 0, nullptr); }
-  void start_timers() { check_call(start_timers_func, 0, nullptr); }
-  void stop_timers() { check_call(stop_timers_func, 0, nullptr); }
-  void cleanup() { check_call(cleanup_func, 0, nullptr); }
+  void start_timers() { start_timers_func(exec_env.get()); }
+  void stop_timers() { stop_timers_func(exec_env.get()); }
+  void cleanup() { cleanup_func(exec_env.get()); }
+
+  bool async_cleanup() { return async_cleanup_func(exec_env.get()); }
+
+  bool has_main() const { return (bool)start_func; }
 
-  bool async_cleanup() {
-    wasm_val_t results[1] = { WASM_I32_VAL(0) };
-    check_call_a(async_cleanup_func, 1, results, 0, nullptr);
-    return results[0].of.i32;
+  // WASI command: runs _start to completion; false if it trapped
+  bool run_main() {
+    return wasm_application_execute_main(module_inst.get(), 0, nullptr);
+  }
+
+  const char *get_exception() const {
+    return wasm_runtime_get_exception(module_inst.get());
+  }
+
+  bool has_stress() const {
+    return stress_create_timers_func && stress_start_producers_func &&
+           stress_stop_producers_func && stress_free_timers_func;
+  }
+
+  // Returns the number of timers created
+  uint32_t stress_create_timers(uint32_t count, uint32_t seed,
+                                uint32_t min_period, uint32_t max_period,
+                                uint32_t oneshot_pct, uint32_t slack) {
+    return stress_create_timers_func(exec_env.get(), count, seed, min_period,
+                                     max_period, oneshot_pct, slack);
+  }
+
+  void stress_start_producers(uint32_t count, uint32_t rate, uint32_t seed,
+                              uint32_t min_period, uint32_t max_period) {
+    stress_start_producers_func(exec_env.get(), count, rate, seed, min_period,
+                                max_period);
+  }
+
+  // Returns the number of commands the producers sent
+  uint32_t stress_stop_producers() {
+    return stress_stop_producers_func(exec_env.get());
+  }
+
+  // After shutdown(): the timers are plain module memory
+  void stress_free_timers() { stress_free_timers_func(exec_env.get()); }
+
+  // Until the module reports its timer queue stopped, or 'timeout'
+  template<typename Rep, typename Period>
+  bool wait_queue_stopped(std::chrono::duration<Rep, Period> timeout) {
+    std::unique_lock<std::mutex> lock(queue_stop_mutex);
+    return queue_stop_cv.wait_for(lock, timeout,
+                                  [this]() { return queue_stopped; });
+  }
+
+  // Stops and destroys the module's timer queue, waiting for its
+  // notification rather than polling
+  void shutdown() {
+    if (!async_cleanup_func) {
+      if (cleanup_func) cleanup();
+      return;
+    }
+    while (!async_cleanup()) {
+      // no notification comes if the stop command could not be queued
+      wait_queue_stopped(100ms);
+    }
   }
 };
 
-const auto WAMRRunner::function_is_null = std::invalid_argument("function is null");
+// Warm instances of one module, each with its own exec env and its own
+// host thread. WAMR ties an exec env to the thread that first used it: an
+// instance's thread creates it, makes every call to it, and destroys it.
+class instance_pool {
+  std::shared_ptr<WAMRModule> module;
+  instance_sizes sizes;
+  uint32_t prewarm_threads;
+
+  struct driver_t {
+    std::unique_ptr<WAMRRunner> runner;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    // set by the pool, cleared by the thread once done
+    std::function<void(WAMRRunner&)> job;
+    // instantiated, or failed to
+    bool ready = false;
+    bool instantiated = false;
+    bool exit = false;
+  };
+  std::vector<std::unique_ptr<driver_t>> drivers;
+
+  // taken from the first instance, if enabled
+  bool use_snapshot = false;
+  std::shared_ptr<const runner_snapshot> snapshot;
+
+  void drive(driver_t &d, bool capture) {
+    bool thread_env = wasm_runtime_init_thread_env();
+    uint64_t cpu_start = thread_cpu_ns();
+    auto runner = std::make_unique<WAMRRunner>(module);
+    bool instantiated = false;
+    try {
+      std::shared_ptr<const runner_snapshot> captured;
+      instantiated = thread_env &&
+                     runner->instantiate(sizes, snapshot.get(),
+                                         capture ? &captured : nullptr);
+      if (instantiated && capture) {
+        // 'snapshot' is only read once 'ready' is set
+        snapshot = captured;
+        if (!snapshot) {
+          std::cerr << "Failed to take instance snapshot" << std::endl;
+          use_snapshot = false;
+        }
+      }
+      if (instantiated) {
+        runner->prewarm_threads(prewarm_threads);
+        runner->add_host_cpu(thread_cpu_ns() - cpu_start);
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "Failed to initialize instance: " << e.what() << std::endl;
+      instantiated = false;
+    }
+
+    std::unique_lock<std::mutex> lock(d.mutex);
+    d.runner = std::move(runner);
+    d.instantiated = instantiated;
+    d.ready = true;
+    d.cond.notify_all();
+
+    while (instantiated) {
+      d.cond.wait(lock, [&]() { return d.job || d.exit; });
+      if (!d.job) break;
+
+      lock.unlock();
+      cpu_start = thread_cpu_ns();
+      d.job(*d.runner);
+      d.runner->add_host_cpu(thread_cpu_ns() - cpu_start);
+      lock.lock();
+
+      d.job = nullptr;
+      d.cond.notify_all();
+    }
+
+    // on its own thread too
+    d.runner.reset();
+    lock.unlock();
+    if (thread_env) wasm_runtime_destroy_thread_env();
+  }
+
+public:
+  explicit instance_pool(std::shared_ptr<WAMRModule> module,
+                         const instance_sizes &sizes = instance_sizes(),
+                         uint32_t prewarm_threads = 0)
+      : module(std::move(module)), sizes(sizes),
+        prewarm_threads(prewarm_threads) {}
+  instance_pool(const instance_pool&) = delete;
+  void operator=(const instance_pool&) = delete;
+
+  ~instance_pool() {
+    for (auto &d : drivers) {
+      {
+        std::lock_guard<std::mutex> lock(d->mutex);
+        d->exit = true;
+      }
+      d->cond.notify_all();
+      d->thread.join();
+    }
+  }
+
+  // Instantiates 'count' more instances up front, one after the other
+  bool fill(unsigned count) {
+    for (unsigned i = 0; i < count; i++) {
+      bool capture = use_snapshot && !snapshot;
+      drivers.push_back(std::make_unique<driver_t>());
+      driver_t &d = *drivers.back();
+      d.thread = std::thread([this, &d, capture]() { drive(d, capture); });
+
+      bool instantiated;
+      {
+        std::unique_lock<std::mutex> lock(d.mutex);
+        d.cond.wait(lock, [&]() { return d.ready; });
+        instantiated = d.instantiated;
+      }
+      if (!instantiated) {
+        // its thread has already returned: no runner, and no jobs taken
+        d.thread.join();
+        drivers.pop_back();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  size_t size() const { return drivers.size(); }
+
+  // Before fill(): later instances restore the first one's initialized
+  // memory instead of initializing themselves
+  void enable_snapshot() { use_snapshot = true; }
+
+  // Null until fill() took one
+  const runner_snapshot *get_snapshot() const { return snapshot.get(); }
+
+  // Summed over the instances, once they are idle
+  uint64_t cpu_ns() const {
+    uint64_t ns = 0;
+    for (auto &d : drivers) ns += d->runner->cpu_ns();
+    return ns;
+  }
+
+  uint64_t memory_bytes() const {
+    uint64_t bytes = 0;
+    for (auto &d : drivers) bytes += d->runner->memory_bytes();
+    return bytes;
+  }
+
+  // Runs 'job' once per instance, all concurrently, each on its instance's
+  // thread. Returns the number of jobs that failed.
+  unsigned run_all(const std::function<void(WAMRRunner&, unsigned)> &job) {
+    std::atomic<unsigned> failed = {0};
+
+    for (unsigned i = 0; i < drivers.size(); i++) {
+      driver_t &d = *drivers[i];
+      std::lock_guard<std::mutex> lock(d.mutex);
+      d.job = [&, i](WAMRRunner &runner) {
+        try {
+          job(runner, i);
+        } catch (const std::exception& e) {
+          std::cerr << "Error [" << i << "]: " << e.what() << std::endl;
+          failed++;
+        }
+      };
+      d.cond.notify_all();
+    }
+
+    for (auto &d : drivers) {
+      std::unique_lock<std::mutex> lock(d->mutex);
+      d->cond.wait(lock, [&]() { return !d->job; });
+    }
+    return failed;
+  }
+};
 
 static unsigned long get_time_ms() {
-  static auto _start = std::chrono::steady_clock::now();;
   auto now = std::chrono::steady_clock::now();
-  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(now - _start);
+  auto duration = std::chrono::duration_cast<std::chrono::microseconds>(now - _start_time);
   return duration.count() / 1000;
 }
 
+static void print_histogram(const char* name, const timer_histogram_t &h) {
+  printf(" -> %-18s count=%u p50=%u p99=%u max=%u\n", name, h.count,
+         timer_hist_percentile(h, 50), timer_hist_percentile(h, 99), h.max);
+}
+
+static void print_timer_stats(const timer_stats_t &stats) {
+  printf("timer stats:\n");
+  print_histogram("fire delay (us)", stats.fire_delay_us);
+  print_histogram("callback (us)", stats.callback_us);
+  print_histogram("cmds per wakeup", stats.cmds_per_wakeup);
+  print_histogram("deferred (us)", stats.deferred_delay_us);
+  printf(" -> %-18s %u\n", "wakeups", stats.wakeups);
+  printf(" -> %-18s %u (max %u)\n", "active timers", stats.active_timers,
+         stats.active_timers_max);
+  printf(" -> %-18s %u\n", "missed deadlines", stats.missed_deadlines);
+  printf(" -> %-18s %u\n", "timer cpu (us)", stats.timer_cpu_us);
+  fflush(stdout);
+}
+
+// Host-side counterpart of the module's timer_stats_merge()
+static void merge_timer_stats(timer_stats_t &dst, const timer_stats_t &src) {
+  auto merge = [](timer_histogram_t &d, const timer_histogram_t &s) {
+    for (unsigned b = 0; b < TIMER_HIST_BUCKETS; b++) d.buckets[b] += s.buckets[b];
+    d.count += s.count;
+    d.max = std::max(d.max, s.max);
+  };
+  merge(dst.fire_delay_us, src.fire_delay_us);
+  merge(dst.callback_us, src.callback_us);
+  merge(dst.cmds_per_wakeup, src.cmds_per_wakeup);
+  merge(dst.deferred_delay_us, src.deferred_delay_us);
+  dst.wakeups += src.wakeups;
+  dst.active_timers += src.active_timers;
+  dst.active_timers_max = std::max(dst.active_timers_max, src.active_timers_max);
+  dst.missed_deadlines += src.missed_deadlines;
+  dst.timer_cpu_us += src.timer_cpu_us;
+}
+
+static void print_mem_profile(const mem_profile &profile) {
+  printf("memory profile:\n");
+  printf(" -> %-18s %u -> %u\n", "memory pages", profile.memory_pages_initial,
+         profile.memory_pages_peak);
+  printf(" -> %-18s %u\n", "malloc heap", profile.heap_peak);
+  if (profile.interp_stack_peak) {
+    printf(" -> %-18s %u\n", "exec env stack", profile.interp_stack_peak);
+  }
+  for (size_t i = 0; i < profile.stacks.size(); i++) {
+    printf(" -> stack %-12zu %u / %u\n", i, profile.stacks[i].peak,
+           profile.stacks[i].size);
+  }
+  fflush(stdout);
+}
+
 static void _log_func(wasm_exec_env_t exec_env, const char* buf, int buf_len) {
   static std::mutex _m;
+  std::string source = WAMRRunner::log_source(exec_env);
   std::lock_guard<std::mutex> _g(_m);
-  (void)exec_env;
-  printf("WASM: [%6lums] %.*s\n", get_time_ms(), buf_len, buf);
+  printf("WASM%s%s: [%6lums] %.*s\n", source.empty() ? "" : " ",
+         source.c_str(), get_time_ms(), buf_len, buf);
   fflush(stdout);
 }
 
+static void _host_timer_arm(wasm_exec_env_t exec_env, uint32_t delay_us) {
+  host_timer_loop::arm(exec_env, delay_us);
+}
+
+static void _host_queue_stopped(wasm_exec_env_t exec_env) {
+  WAMRRunner::notify_queue_stopped(exec_env);
+}
+
+// --profile: wasm function times of every instance, module threads included
+static std::atomic<bool> _profiling = {false};
+static perf_profile _perf_profile;
+
+static void _host_thread_exit(wasm_exec_env_t exec_env) {
+  WAMRRunner::notify_thread_exit(exec_env);
+  if (_profiling) _perf_profile.collect(wasm_runtime_get_module_inst(exec_env));
+}
+
 static NativeSymbol native_symbols[] = {
   EXPORT_WASM_API_WITH_SIG(_log_func, "(*i)"),
+  EXPORT_WASM_API_WITH_SIG(_host_timer_arm, "(i)"),
+  EXPORT_WASM_API_WITH_SIG(_host_queue_stopped, "()"),
+  EXPORT_WASM_API_WITH_SIG(_host_thread_exit, "()"),
 };
 
 
+// Whole-string, non-negative decimal that fits 'value'; std::stoul would
+// throw on a typo, and wrap a negative number around.
+template <typename T>
+static bool parse_number(const std::string &text, T &value) {
+  if (text.empty() || !isdigit((unsigned char)text[0])) return false;
+
+  errno = 0;
+  char *end;
+  unsigned long long n = strtoull(text.c_str(), &end, 10);
+  if (errno || *end || n > (unsigned long long)std::numeric_limits<T>::max()) {
+    return false;
+  }
+  value = (T)n;
+  return true;
+}
+
+static int usage(const char *prog) {
+  std::cerr << "Usage: " << prog << " [options] <wasm_file>..." << std::endl
+            << "Several modules share the process, each with its own instances."
+            << std::endl
+            << "Options:" << std::endl
+            << "  --timer-workers N   run timer callbacks on N worker threads"
+            << std::endl
+            << "  --timers N          add N timers, configured in batches"
+            << std::endl
+            << "  --timer-slack MS    let these timers fire up to MS late"
+            << std::endl
+            << "  --log-level LEVEL   error, warn, info (default) or debug"
+            << std::endl
+            << "  --aot-cache DIR     compiled module cache directory"
+            << std::endl
+            << "  --no-aot            always run on the interpreter"
+            << std::endl
+            << "  --scrape MS         print a counter snapshot every MS while running"
+            << std::endl
+            << "  --mem-profile FILE  record memory usage and save it to FILE"
+            << std::endl
+            << "  --mem-sizes FILE    size instances from a saved memory profile"
+            << std::endl
+            << "  --stack-size BYTES  exec env stack size (default 65536)"
+            << std::endl
+            << "  --heap-size BYTES   host-managed app heap size (default 65536)"
+            << std::endl
+            << "  --max-memory-pages N  cap linear memory at N 64KB pages"
+            << std::endl
+            << "  --thread-stack-size BYTES  module thread stack size"
+            << std::endl
+            << "  --max-threads N     module threads per instance (default: as needed)"
+            << std::endl
+            << "  --prewarm-threads N threads parked at instantiation (default: as needed)"
+            << std::endl
+            << "  -j N                run N instances of each module concurrently"
+            << std::endl
+            << "  --snapshot          with -j, restore instances from the first one"
+            << std::endl
+            << "  --profile           time host calls and wasm functions"
+            << std::endl
+            << "Stress mode (bench_module.wasm):" << std::endl
+            << "  --stress N          run N random timers per instance"
+            << std::endl
+            << "  --producers N       command producer threads (default 4)"
+            << std::endl
+            << "  --duration S        run for S seconds (default 10)"
+            << std::endl
+            << "  --rate N            commands/s per producer, 0 for max (default)"
+            << std::endl
+            << "  --periods MIN:MAX   timer periods in ms (default 1:1000)"
+            << std::endl
+            << "  --oneshot PCT       one-shot timer percentage (default 20)"
+            << std::endl
+            << "  --seed N            random seed (default 1)"
+            << std::endl;
+  return 1;
+}
+
+struct run_options {
+  unsigned timer_workers = 0;
+  unsigned extra_timers = 0;
+  unsigned timer_slack = 0;
+  module_log_level_t log_level = LOG_LEVEL_INFO;
+  // counter snapshot period while timers run, 0 for none
+  unsigned scrape_ms = 0;
+  // record a memory profile, merged into '_mem_profile'
+  bool mem_profile = false;
+  // collect wasm function times into '_perf_profile'
+  bool profile = false;
+  // --stress: timers per instance, 0 for a normal run
+  unsigned stress_timers = 0;
+  unsigned stress_producers = 4;
+  unsigned stress_seconds = 10;
+  unsigned stress_rate = 0;
+  unsigned stress_min_period = 1;
+  unsigned stress_max_period = 1000;
+  unsigned stress_oneshot_pct = 20;
+  unsigned stress_seed = 1;
+};
+
+// serializes the output of concurrent instances
+static std::mutex _output_mutex;
+
+// linear memory sampling period
+static constexpr auto mem_sample_period = 10ms;
+
+static std::mutex _mem_profile_mutex;
+static mem_profile _mem_profile;
+
+// Runs the module's timers for 2s, then prints its counters; 'tag'
+// prefixes the progress lines.
+// Modules without the timer exports: runs a WASI command's _start, or else
+// only keeps the instance for as long as a timer run lasts.
+static void run_entry_point(WAMRRunner &runner, const run_options &opts,
+                            const std::function<void(const std::string&)> &say,
+                            bool profiling) {
+  if (runner.has_main()) {
+    say("running _start");
+    if (!runner.run_main()) {
+      const char *exception = runner.get_exception();
+      throw std::runtime_error(std::string("_start failed: ") +
+                               (exception ? exception : "unknown error"));
+    }
+    say("_start returned");
+  } else {
+    say("no entry point, holding the instance for 2000ms");
+    std::this_thread::sleep_for(2020ms);
+  }
+
+  if (opts.profile) runner.collect_perf_profile(_perf_profile);
+  if (profiling) {
+    std::lock_guard<std::mutex> lock(_mem_profile_mutex);
+    _mem_profile.merge(runner.finish_mem_profile());
+  }
+}
+
+static void run_instance(WAMRRunner &runner, const run_options &opts,
+                         const std::string &tag) {
+  auto say = [&](const std::string &line) {
+    std::lock_guard<std::mutex> lock(_output_mutex);
+    std::cout << tag << line << std::endl;
+  };
+
+  runner.set_log_level(opts.log_level);
+
+  // before the module starts any thread
+  bool profiling = opts.mem_profile && runner.start_mem_profile();
+  if (opts.mem_profile && !profiling) {
+    say("Module does not export get_mem_usage, no memory profile");
+  }
+
+  if (!runner.has_timer_run()) {
+    run_entry_point(runner, opts, say, profiling);
+    return;
+  }
+
+  say("Module name: " + runner.get_module_name());
+  if (runner.uses_host_timers()) {
+    say("Timers driven by the host event loop");
+  }
+
+  if (opts.timer_workers > 0 &&
+      !runner.start_timer_workers(opts.timer_workers)) {
+    say("Module has no timer workers");
+  }
+  runner.start_timers();
+
+  std::vector<uint32_t> timer_ids;
+  if (opts.extra_timers > 0) {
+    timer_ids = runner.create_timers(opts.extra_timers, 0, opts.timer_slack);
+    if (timer_ids.size() < opts.extra_timers) {
+      std::cerr << tag << "only " << timer_ids.size() << " timers available"
+                << std::endl;
+    }
+    std::vector<uint32_t> periods;
+    for (uint32_t i = 0; i < timer_ids.size(); i++) {
+      periods.push_back(100 + (i % 10) * 50);
+    }
+    runner.set_timer_periods(timer_ids, periods);
+  }
+
+  say("sleep 2000ms...");
+  if (opts.scrape_ms || profiling) {
+    using clock = std::chrono::steady_clock;
+    auto end = clock::now() + 2020ms;
+    auto scrape_period = std::chrono::milliseconds(opts.scrape_ms);
+    auto next_scrape = clock::now() + scrape_period;
+    std::vector<uint32_t> snapshot;
+
+    while (clock::now() < end) {
+      clock::duration tick = end - clock::now();
+      if (profiling) tick = std::min<clock::duration>(tick, mem_sample_period);
+      if (opts.scrape_ms) tick = std::min(tick, next_scrape - clock::now());
+      std::this_thread::sleep_for(tick);
+
+      if (profiling) runner.sample_memory();
+      if (!opts.scrape_ms || clock::now() < next_scrape) continue;
+
+      next_scrape += scrape_period;
+      if (!runner.snapshot_counters(snapshot)) continue;
+
+      std::string line = "counters:";
+      for (auto counter : snapshot) line += " " + std::to_string(counter);
+      say(line);
+    }
+  } else {
+    std::this_thread::sleep_for(2020ms);
+  }
+  say("...done");
+
+  runner.stop_timers();
+  if (!timer_ids.empty()) {
+    runner.stop_timers(timer_ids);
+    runner.destroy_timers(timer_ids);
+  }
+
+  say("cleanup");
+  runner.shutdown();
+  if (opts.profile) runner.collect_perf_profile(_perf_profile);
+
+  std::vector<uint32_t> counters;
+  runner.get_counters(counters);
+
+  timer_stats_t stats;
+  bool has_stats = runner.get_timer_stats(stats);
+
+  if (profiling) {
+    std::lock_guard<std::mutex> lock(_mem_profile_mutex);
+    _mem_profile.merge(runner.finish_mem_profile());
+  }
+
+  std::lock_guard<std::mutex> lock(_output_mutex);
+  std::cout << tag << "counters:" << std::endl;
+  for (auto counter : counters) {
+    std::cout << " -> " << counter << std::endl;
+  }
+  if (has_stats) {
+    print_timer_stats(stats);
+  }
+}
+
+// totals of all stress instances
+struct stress_totals {
+  std::mutex mutex;
+  uint64_t timers = 0;
+  uint64_t commands = 0;
+  timer_stats_t stats = {};
+};
+static stress_totals _stress;
+
+// Runs 'opts.stress_timers' random timers and producer threads hammering
+// them with commands for 'opts.stress_seconds', then merges the instance's
+// timer stats into '_stress'.
+static void run_stress(WAMRRunner &runner, const run_options &opts,
+                       const std::string &tag, unsigned index) {
+  if (!runner.has_stress()) {
+    throw std::runtime_error("module has no stress exports, "
+                             "use bench_module.wasm");
+  }
+  runner.set_log_level(opts.log_level);
+  if (opts.timer_workers > 0) {
+    runner.start_timer_workers(opts.timer_workers);
+  }
+
+  // different timer populations per instance, reproducible per seed
+  uint32_t seed = opts.stress_seed + index;
+  uint32_t timers = runner.stress_create_timers(
+      opts.stress_timers, seed, opts.stress_min_period, opts.stress_max_period,
+      opts.stress_oneshot_pct, opts.timer_slack);
+  runner.stress_start_producers(opts.stress_producers, opts.stress_rate, seed,
+                                opts.stress_min_period, opts.stress_max_period);
+
+  std::this_thread::sleep_for(std::chrono::seconds(opts.stress_seconds));
+
+  uint32_t commands = runner.stress_stop_producers();
+  timer_stats_t stats;
+  bool has_stats = runner.get_timer_stats(stats);
+  runner.shutdown();
+  runner.stress_free_timers();
+  if (opts.profile) runner.collect_perf_profile(_perf_profile);
+
+  {
+    std::lock_guard<std::mutex> lock(_stress.mutex);
+    _stress.timers += timers;
+    _stress.commands += commands;
+    if (has_stats) merge_timer_stats(_stress.stats, stats);
+  }
+
+  std::lock_guard<std::mutex> lock(_output_mutex);
+  std::cout << tag << timers << " timers, " << commands << " commands, "
+            << (has_stats ? stats.fire_delay_us.count : 0) << " fired"
+            << std::endl;
+}
+
+static void print_stress_report(const run_options &opts, unsigned jobs) {
+  const timer_stats_t &stats = _stress.stats;
+  double seconds = opts.stress_seconds;
+  uint32_t fired = stats.fire_delay_us.count;
+
+  printf("stress: %u instance(s) x %u timers, %u producers, %us\n", jobs,
+         opts.stress_timers, opts.stress_producers, opts.stress_seconds);
+  printf(" -> %-18s %llu (%.0f/s)\n", "commands",
+         (unsigned long long)_stress.commands, _stress.commands / seconds);
+  printf(" -> %-18s %u (%.0f/s)\n", "fired", fired, fired / seconds);
+  printf(" -> %-18s p50=%u p90=%u p99=%u max=%u\n", "fire delay (us)",
+         timer_hist_percentile(stats.fire_delay_us, 50),
+         timer_hist_percentile(stats.fire_delay_us, 90),
+         timer_hist_percentile(stats.fire_delay_us, 99),
+         stats.fire_delay_us.max);
+  printf(" -> %-18s %u (%.2f%% of fires)\n", "missed deadlines",
+         stats.missed_deadlines,
+         fired ? 100.0 * stats.missed_deadlines / fired : 0.0);
+  // over all the instances' timer threads
+  printf(" -> %-18s %.0fms (%.1f%% of one core)\n", "timer cpu",
+         stats.timer_cpu_us / 1000.0,
+         stats.timer_cpu_us / (10000.0 * seconds));
+  printf(" -> %-18s %u\n", "active timers max", stats.active_timers_max);
+
+  uint64_t rss_kb, peak_kb;
+  if (read_process_rss(rss_kb, peak_kb)) {
+    printf(" -> %-18s %llu KB (peak %llu KB)\n", "process rss",
+           (unsigned long long)rss_kb, (unsigned long long)peak_kb);
+  }
+  fflush(stdout);
+}
+
+// A module of the process, and its instances
+struct hosted_module {
+  std::string name;
+  std::shared_ptr<WAMRModule> module;
+  std::unique_ptr<instance_pool> pool;
+};
+
+// Module names, from their file names; repeated ones are numbered
+static std::vector<std::string> module_names(
+    const std::vector<std::string> &files) {
+  std::vector<std::string> bases, names;
+  for (const auto &file : files) {
+    size_t slash = file.rfind('/');
+    std::string base = file.substr(slash == std::string::npos ? 0 : slash + 1);
+    base = base.substr(0, base.rfind(".wasm"));
+
+    unsigned same = std::count(bases.begin(), bases.end(), base);
+    bases.push_back(base);
+    names.push_back(same ? base + "#" + std::to_string(same + 1) : base);
+  }
+  return names;
+}
+
+static void print_module_usage(const std::vector<hosted_module> &hosted) {
+  printf("modules:\n");
+  printf("%-24s %10s %12s %14s %10s\n", "module", "instances", "image (KB)",
+         "memory (KB)", "cpu (ms)");
+  for (const auto &h : hosted) {
+    printf("%-24s %10zu %12zu %14llu %10.1f\n", h.name.c_str(),
+           h.pool->size(), h.module->image_size() / 1024,
+           (unsigned long long)h.pool->memory_bytes() / 1024,
+           h.pool->cpu_ns() / 1e6);
+  }
+
+  uint64_t rss_kb, peak_kb;
+  if (read_process_rss(rss_kb, peak_kb)) {
+    printf("process rss: %llu KB (peak %llu KB)\n",
+           (unsigned long long)rss_kb, (unsigned long long)peak_kb);
+  }
+  fflush(stdout);
+}
+
+static void print_profile() {
+  printf("host calls:\n");
+  printf("%-32s %10s %12s %12s %12s\n", "export", "calls", "total (ms)",
+         "per call (us)", "max (us)");
+  wasm_call_profile::for_each(
+      [](const std::string &name, const wasm_call_stats &stats) {
+        uint64_t calls = stats.calls, total_ns = stats.total_ns;
+        printf("%-32s %10llu %12.3f %12.3f %12.3f\n", name.c_str(),
+               (unsigned long long)calls, total_ns / 1e6,
+               total_ns / 1e3 / calls, stats.max_ns / 1e3);
+      });
+
+  if (_perf_profile.empty()) {
+    printf("no wasm function times: build with -DWAMR_PERF_PROFILING=ON\n");
+  } else {
+    _perf_profile.print(stdout);
+  }
+
+  // written by WAMR while loading AOT code
+  std::string perf_map = "/tmp/perf-" + std::to_string(getpid()) + ".map";
+  if (access(perf_map.c_str(), R_OK) == 0) {
+    printf("perf map: %s\n", perf_map.c_str());
+  }
+  fflush(stdout);
+}
+
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: " << argv[0] << " <wasm_file>" << std::endl;
+  std::vector<std::string> wasm_files;
+  run_options opts;
+  bool use_aot = true;
+  std::string aot_cache_dir;
+  unsigned jobs = 1;
+  std::string mem_profile_file;
+  std::string mem_sizes_file;
+  // set explicitly, over any derived value
+  long stack_size = -1, heap_size = -1, max_memory_pages = -1;
+  long thread_stack_size = -1, max_threads = -1, prewarm_threads = -1;
+  bool use_snapshot = false;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--timer-workers" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.timer_workers)) return usage(argv[0]);
+    } else if (arg == "--timers" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.extra_timers)) return usage(argv[0]);
+    } else if (arg == "--timer-slack" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.timer_slack)) return usage(argv[0]);
+    } else if (arg == "--log-level" && i + 1 < argc) {
+      if (!parse_log_level(argv[++i], opts.log_level)) return usage(argv[0]);
+    } else if (arg == "--aot-cache" && i + 1 < argc) {
+      aot_cache_dir = argv[++i];
+    } else if (arg == "--no-aot") {
+      use_aot = false;
+    } else if (arg == "--scrape" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.scrape_ms)) return usage(argv[0]);
+    } else if (arg == "--mem-profile" && i + 1 < argc) {
+      mem_profile_file = argv[++i];
+      opts.mem_profile = true;
+    } else if (arg == "--mem-sizes" && i + 1 < argc) {
+      mem_sizes_file = argv[++i];
+    } else if (arg == "--stack-size" && i + 1 < argc) {
+      if (!parse_number(argv[++i], stack_size)) return usage(argv[0]);
+    } else if (arg == "--heap-size" && i + 1 < argc) {
+      if (!parse_number(argv[++i], heap_size)) return usage(argv[0]);
+    } else if (arg == "--max-memory-pages" && i + 1 < argc) {
+      if (!parse_number(argv[++i], max_memory_pages)) return usage(argv[0]);
+    } else if (arg == "--thread-stack-size" && i + 1 < argc) {
+      if (!parse_number(argv[++i], thread_stack_size)) return usage(argv[0]);
+    } else if (arg == "--max-threads" && i + 1 < argc) {
+      if (!parse_number(argv[++i], max_threads)) return usage(argv[0]);
+    } else if (arg == "--prewarm-threads" && i + 1 < argc) {
+      if (!parse_number(argv[++i], prewarm_threads)) return usage(argv[0]);
+    } else if (arg == "--profile") {
+      opts.profile = true;
+    } else if (arg == "--snapshot") {
+      use_snapshot = true;
+    } else if (arg == "--stress" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.stress_timers) || !opts.stress_timers) {
+        return usage(argv[0]);
+      }
+    } else if (arg == "--producers" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.stress_producers)) {
+        return usage(argv[0]);
+      }
+    } else if (arg == "--duration" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.stress_seconds)) return usage(argv[0]);
+    } else if (arg == "--rate" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.stress_rate)) return usage(argv[0]);
+    } else if (arg == "--periods" && i + 1 < argc) {
+      std::string periods(argv[++i]);
+      size_t colon = periods.find(':');
+      if (colon == std::string::npos) return usage(argv[0]);
+      if (!parse_number(periods.substr(0, colon), opts.stress_min_period) ||
+          !parse_number(periods.substr(colon + 1), opts.stress_max_period) ||
+          !opts.stress_min_period ||
+          opts.stress_min_period > opts.stress_max_period) {
+        return usage(argv[0]);
+      }
+    } else if (arg == "--oneshot" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.stress_oneshot_pct)) {
+        return usage(argv[0]);
+      }
+    } else if (arg == "--seed" && i + 1 < argc) {
+      if (!parse_number(argv[++i], opts.stress_seed)) return usage(argv[0]);
+    } else if (arg == "-j" && i + 1 < argc) {
+      if (!parse_number(argv[++i], jobs) || !jobs) return usage(argv[0]);
+    } else if (arg[0] != '-') {
+      wasm_files.push_back(arg);
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  if (wasm_files.empty()) {
+    return usage(argv[0]);
+  }
+  if (wasm_files.size() > 1 &&
+      (!mem_profile_file.empty() || !mem_sizes_file.empty())) {
+    // sizes are derived from, and for, one module
+    std::cerr << "--mem-profile and --mem-sizes take a single module"
+              << std::endl;
     return 1;
   }
 
+  instance_sizes sizes;
+  if (!mem_sizes_file.empty()) {
+    mem_profile profile;
+    if (!profile.load(mem_sizes_file)) {
+      std::cerr << "Failed to read memory profile: " << mem_sizes_file
+                << std::endl;
+      return 1;
+    }
+    sizes = derive_sizes(profile, sizes);
+  }
+  if (stack_size >= 0) sizes.stack_size = stack_size;
+  if (heap_size >= 0) sizes.heap_size = heap_size;
+  if (max_memory_pages >= 0) sizes.max_memory_pages = max_memory_pages;
+  if (thread_stack_size >= 0) sizes.thread_stack_size = thread_stack_size;
+
+  // module threads of one instance: timer thread, pend_function() executor,
+  // workers and stress producers
+  unsigned producers = opts.stress_timers ? opts.stress_producers : 0;
+  unsigned run_threads = 2 + opts.timer_workers + producers;
+  if (prewarm_threads < 0) prewarm_threads = run_threads;
+  if (max_threads < 0) {
+    // parked threads count against the limit too; one spare
+    max_threads = std::max<long>(run_threads, prewarm_threads) + 1;
+  }
+
   try {
-    WAMRRunner runner;
-    if (!runner.initialize(native_symbols, 1)) {
+    auto runtime = std::make_shared<WAMRRuntime>();
+    unsigned n_symbols = sizeof(native_symbols) / sizeof(NativeSymbol);
+    if (opts.profile) {
+      // before any export is bound
+      wasm_call_profile::enable();
+      _profiling = true;
+    }
+    if (!runtime->initialize(native_symbols, n_symbols, max_threads,
+                             opts.profile)) {
       return 1;
     }
     std::cout << "WAMR initialised" << std::endl;
 
-    if (!runner.loadWasmFile(argv[1])) {
-      return 1;
+    // one runtime, log sink and host timer loop for all of them
+    bool multi = wasm_files.size() > 1;
+    auto names = module_names(wasm_files);
+    std::vector<hosted_module> hosted;
+    for (size_t m = 0; m < wasm_files.size(); m++) {
+      auto module = std::make_shared<WAMRModule>(
+          runtime, multi ? names[m] : std::string());
+      if (use_aot) {
+        module->use_aot_cache(aot_cache_dir);
+      }
+      if (!module->load(wasm_files[m])) {
+        return 1;
+      }
+      std::cout << "WASM module loaded: " << names[m] << ", "
+                << module->exports().size() << " exported functions, entry "
+                << "point: " << WAMRRunner::entry_point(*module) << std::endl;
+      if (!module->aot_module_key().empty()) {
+        std::cout << "Running AOT module " << module->aot_module_key()
+                  << std::endl;
+      }
+      hosted.push_back({names[m], module, nullptr});
     }
-    std::cout << "WASM module loaded" << std::endl;
 
-    std::string module_name{runner.get_module_name()};
-    std::cout << "Module name: " << module_name << std::endl;
+    std::cout << "Instance sizes: stack " << sizes.stack_size << ", heap "
+              << sizes.heap_size << ", max memory pages "
+              << sizes.max_memory_pages << ", thread stack "
+              << sizes.thread_stack_size << std::endl;
+    std::cout << "Module threads: up to " << max_threads << " per instance, "
+              << prewarm_threads << " prewarmed" << std::endl;
 
-    runner.create_timers();
-    runner.start_timers();
+    for (auto &h : hosted) {
+      h.pool = std::make_unique<instance_pool>(h.module, sizes,
+                                               prewarm_threads);
+      if (use_snapshot) h.pool->enable_snapshot();
+      auto fill_start = std::chrono::steady_clock::now();
+      if (!h.pool->fill(jobs)) {
+        return 1;
+      }
+      if (jobs == 1) continue;
 
-    std::cout << "sleep 2000ms..." << std::endl;
-    std::this_thread::sleep_for(2020ms);
-    std::cout << "...done" << std::endl;
+      auto fill_us = std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - fill_start);
+      std::cout << (multi ? h.name + ": " : "") << jobs
+                << " instances ready in " << fill_us.count() / 1000.0 << "ms"
+                << std::endl;
+      if (auto snapshot = h.pool->get_snapshot()) {
+        std::cout << "Restored from a " << snapshot->image.size() / 1024
+                  << "KB snapshot" << std::endl;
+      }
+    }
+
+    // every instance of every module at once
+    std::vector<unsigned> failed(hosted.size());
+    std::vector<std::thread> runs;
+    for (size_t m = 0; m < hosted.size(); m++) {
+      runs.emplace_back([&, m]() {
+        failed[m] = hosted[m].pool->run_all([&](WAMRRunner &runner, unsigned i) {
+          std::string tag;
+          if (multi) {
+            tag = "[" + hosted[m].name +
+                  (jobs > 1 ? ":" + std::to_string(i) : "") + "] ";
+          } else if (jobs > 1) {
+            tag = "[" + std::to_string(i) + "] ";
+          }
+          // next to other modules, those without stress exports run as usual
+          if (opts.stress_timers && (!multi || runner.has_stress())) {
+            run_stress(runner, opts, tag, i);
+          } else {
+            run_instance(runner, opts, tag);
+          }
+        });
+      });
+    }
+    for (auto &run : runs) {
+      run.join();
+    }
+
+    bool any_failed = false;
+    for (size_t m = 0; m < hosted.size(); m++) {
+      if (!failed[m]) continue;
+      std::cerr << (multi ? hosted[m].name + ": " : "") << failed[m] << " of "
+                << jobs << " instances failed" << std::endl;
+      any_failed = true;
+    }
+    if (any_failed) {
+      return 1;
+    }
 
-    runner.stop_timers();
+    print_module_usage(hosted);
 
-    std::cout << "cleanup" << std::endl;
-    while (!runner.async_cleanup()) {
-      std::this_thread::sleep_for(100ms);
+    if (opts.stress_timers) {
+      unsigned stressed = 0;
+      for (const auto &h : hosted) {
+        if (!multi || h.module->exports("stress_create_timers")) stressed += jobs;
+      }
+      print_stress_report(opts, stressed);
     }
 
-    std::vector<uint32_t> counters;
-    runner.get_counters(counters);
+    if (opts.profile) {
+      print_profile();
+    }
 
-    std::cout << "counters:" << std::endl;
-    for (auto counter : counters) {
-      std::cout << " -> " << counter << std::endl;
+    if (opts.mem_profile) {
+      print_mem_profile(_mem_profile);
+      if (!_mem_profile.save(mem_profile_file)) {
+        std::cerr << "Failed to write memory profile: " << mem_profile_file
+                  << std::endl;
+      }
     }
 
   } catch (const std::exception& e) {
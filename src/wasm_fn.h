@@ -0,0 +1,194 @@
+#ifndef WASM_FN_H
+#define WASM_FN_H
+
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iostream>
+#include <stdexcept>
+
+#include "call_profile.h"
+#include "wasm_export.h"
+
+// How a C++ type travels through the 32-bit cells of wasm_runtime_call_wasm()
+template<typename T, wasm_valkind_t Kind, typename Cell = T>
+struct wasm_val_traits_base {
+  static constexpr wasm_valkind_t kind() { return Kind; }
+  static constexpr uint32_t cells() { return sizeof(Cell) / sizeof(uint32_t); }
+
+  static void store(uint32_t *argv, T value) {
+    Cell cell = (Cell)value;
+    memcpy(argv, &cell, sizeof(cell));
+  }
+  static T load(const uint32_t *argv) {
+    Cell cell;
+    memcpy(&cell, argv, sizeof(cell));
+    return (T)cell;
+  }
+};
+
+template<typename T> struct wasm_val_traits;
+template<> struct wasm_val_traits<int32_t> : wasm_val_traits_base<int32_t, WASM_I32> {};
+template<> struct wasm_val_traits<uint32_t> : wasm_val_traits_base<uint32_t, WASM_I32> {};
+template<> struct wasm_val_traits<int64_t> : wasm_val_traits_base<int64_t, WASM_I64> {};
+template<> struct wasm_val_traits<uint64_t> : wasm_val_traits_base<uint64_t, WASM_I64> {};
+template<> struct wasm_val_traits<float> : wasm_val_traits_base<float, WASM_F32> {};
+template<> struct wasm_val_traits<double> : wasm_val_traits_base<double, WASM_F64> {};
+template<> struct wasm_val_traits<bool> : wasm_val_traits_base<bool, WASM_I32, uint32_t> {};
+
+template<typename R> struct wasm_result_traits : wasm_val_traits<R> {
+  static constexpr uint32_t count() { return 1; }
+};
+template<> struct wasm_result_traits<void> {
+  static constexpr uint32_t count() { return 0; }
+  static constexpr wasm_valkind_t kind() { return 0; }
+  static constexpr uint32_t cells() { return 0; }
+  static void load(const uint32_t *) {}
+};
+
+template<typename Sig> class wasm_fn;
+
+// Typed handle on an exported function.
+//
+// bind() resolves the export and checks its signature against R(Args...)
+// once; calls then marshal straight into a stack array of cells, without
+// wasm_val_t conversion or per-call type checks.
+template<typename R, typename... Args>
+class wasm_fn<R(Args...)> {
+  wasm_function_inst_t _func = nullptr;
+  // set if bound while profiling
+  wasm_call_stats *_stats = nullptr;
+
+  static constexpr uint32_t param_cells() {
+    uint32_t n = 0;
+    for (uint32_t cells : {wasm_val_traits<Args>::cells()..., 0u}) n += cells;
+    return n;
+  }
+
+  // parameters in, results out
+  static constexpr uint32_t argv_cells() {
+    uint32_t n = param_cells() > wasm_result_traits<R>::cells()
+                     ? param_cells()
+                     : wasm_result_traits<R>::cells();
+    return n ? n : 1;
+  }
+
+  static bool signature_matches(wasm_function_inst_t func,
+                                wasm_module_inst_t module_inst) {
+    if (wasm_func_get_param_count(func, module_inst) != sizeof...(Args) ||
+        wasm_func_get_result_count(func, module_inst) !=
+            wasm_result_traits<R>::count()) {
+      return false;
+    }
+
+    const wasm_valkind_t expected[] = {wasm_val_traits<Args>::kind()..., 0};
+    wasm_valkind_t kinds[sizeof...(Args) + 1];
+    wasm_func_get_param_types(func, module_inst, kinds);
+    for (size_t i = 0; i < sizeof...(Args); i++) {
+      if (kinds[i] != expected[i]) return false;
+    }
+
+    if (wasm_result_traits<R>::count()) {
+      wasm_func_get_result_types(func, module_inst, kinds);
+      if (kinds[0] != wasm_result_traits<R>::kind()) return false;
+    }
+    return true;
+  }
+
+public:
+  // Returns false if 'name' is not exported, or with another signature.
+  bool bind(wasm_module_inst_t module_inst, const char *name) {
+    _func = nullptr;
+    _stats = nullptr;
+    auto func = wasm_runtime_lookup_function(module_inst, name);
+    if (!func) return false;
+
+    if (!signature_matches(func, module_inst)) {
+      std::cerr << "Signature mismatch for export '" << name << "'"
+                << std::endl;
+      return false;
+    }
+    _func = func;
+    _stats = wasm_call_profile::stats(name);
+    return true;
+  }
+
+  explicit operator bool() const { return _func != nullptr; }
+
+  // Throws if unbound, or with the module's exception if the call traps.
+  R operator()(wasm_exec_env_t exec_env, Args... args) const {
+    if (!_func) throw std::invalid_argument("function is null");
+
+    uint32_t argv[argv_cells()];
+    uint32_t offset = 0;
+    (void)offset;
+    using expand = int[];
+    (void)expand{0, (wasm_val_traits<Args>::store(argv + offset, args),
+                     offset += wasm_val_traits<Args>::cells(), 0)...};
+
+    auto start = _stats ? std::chrono::steady_clock::now()
+                        : std::chrono::steady_clock::time_point();
+    bool ok = wasm_runtime_call_wasm(exec_env, _func, param_cells(), argv);
+    if (_stats) _stats->add(std::chrono::steady_clock::now() - start);
+
+    if (!ok) {
+      throw std::runtime_error(
+          wasm_runtime_get_exception(wasm_runtime_get_module_inst(exec_env)));
+    }
+    return wasm_result_traits<R>::load(argv);
+  }
+};
+
+// Module heap region reused by the calls that pass data by address, rather
+// than a malloc/free pair per call. Only grows.
+class wasm_scratch {
+  wasm_module_inst_t _module_inst = nullptr;
+  uint32_t _app = 0;
+  uint32_t _size = 0;
+
+public:
+  wasm_scratch() = default;
+  ~wasm_scratch() { reset(); }
+
+  wasm_scratch(const wasm_scratch&) = delete;
+  void operator=(const wasm_scratch&) = delete;
+
+  // Contents are lost when it has to grow; throws if the module heap is
+  // exhausted.
+  void reserve(wasm_module_inst_t module_inst, uint32_t size) {
+    if (module_inst == _module_inst && size <= _size) return;
+
+    reset();
+    _app = wasm_runtime_module_malloc(module_inst, size, nullptr);
+    if (!_app) throw std::runtime_error("failed to allocate memory");
+    _module_inst = module_inst;
+    _size = size;
+  }
+
+  // Takes over a block allocated before 'module_inst' was restored from a
+  // snapshot
+  void adopt(wasm_module_inst_t module_inst, uint32_t app, uint32_t size) {
+    reset();
+    _module_inst = module_inst;
+    _app = app;
+    _size = size;
+  }
+
+  void reset() {
+    if (_app) wasm_runtime_module_free(_module_inst, _app);
+    _module_inst = nullptr;
+    _app = 0;
+    _size = 0;
+  }
+
+  uint32_t app(uint32_t offset = 0) const { return _app + offset; }
+  uint32_t size() const { return _size; }
+
+  template<typename T = void>
+  T *native(uint32_t offset = 0) const {
+    return static_cast<T *>(
+        wasm_runtime_addr_app_to_native(_module_inst, _app + offset));
+  }
+};
+
+#endif // WASM_FN_H
@@ -0,0 +1,227 @@
+// bench.cpp - exports of bench_module.wasm, driven by wamr_bench
+#include "imp_export.h"
+#include "log.h"
+#include "mpsc_ring.h"
+#include "thread_pool.h"
+#include "timer.h"
+#include "wakeup.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+static timer_handle_t bench_timer = TIMER_INITIALIZER;
+
+static void bench_timer_func(timer_handle_t *) {}
+
+// call overhead baselines
+void WASM_EXPORT(bench_noop)() {}
+
+uint32_t WASM_EXPORT(bench_args)(uint32_t a, uint32_t b, uint32_t c,
+                                 uint32_t d) {
+  return a + b + c + d;
+}
+
+// Sends 'count' start / stop commands for a timer that never fires in
+// between. Returns how many were queued: all of them unless 'async', whose
+// commands fail rather than wait once the command queue is full.
+uint32_t WASM_EXPORT(bench_timer_cmds)(uint32_t count, bool async) {
+  auto &tim = timer_queue::instance();
+  if (!bench_timer.func) {
+    tim.create_timer(&bench_timer, bench_timer_func, "bench timer", 3600000,
+                     false);
+  }
+
+  uint32_t sent = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    if (!async) {
+      if (i & 1) tim.stop_timer(&bench_timer);
+      else tim.start_timer(&bench_timer);
+      sent++;
+    } else if (i & 1 ? tim.stop_timer_async(&bench_timer)
+                     : tim.start_timer_async(&bench_timer)) {
+      sent++;
+    }
+  }
+  tim.stop_timer(&bench_timer);
+  return sent;
+}
+
+// Command queue contention, between wasi threads: the mutex-guarded deque
+// timer_queue used to post commands to, through its blocking and its
+// 'try_to_lock' + spin '*_async' paths, and the mpsc_ring + wakeup_event
+// pair it uses now.
+enum bench_queue_kind : uint32_t {
+  bench_queue_mutex,
+  bench_queue_try_lock,
+  bench_queue_ring,
+};
+
+struct bench_cmd_t {
+  uint32_t producer;
+  uint32_t seq;
+};
+
+class bench_deque_queue {
+  std::deque<bench_cmd_t> _cmds;
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  bool _try_lock;
+
+public:
+  explicit bench_deque_queue(bool try_lock) : _try_lock(try_lock) {}
+
+  void send(const bench_cmd_t &cmd) {
+    if (_try_lock) {
+      while (true) {
+        std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+        if (lock.owns_lock()) {
+          _cmds.emplace_back(cmd);
+          break;
+        }
+      }
+    } else {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _cmds.emplace_back(cmd);
+    }
+    _cond.notify_one();
+  }
+
+  uint32_t drain(uint64_t &sum) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    if (_cmds.empty()) _cond.wait_for(lock, std::chrono::milliseconds(500));
+    uint32_t n = 0;
+    for (; !_cmds.empty(); n++) {
+      sum += _cmds.front().seq;
+      _cmds.pop_front();
+    }
+    return n;
+  }
+};
+
+class bench_ring_queue {
+  mpsc_ring<bench_cmd_t, TIMER_CMD_QUEUE_SIZE> _cmds;
+  wakeup_event _event;
+
+public:
+  void send(const bench_cmd_t &cmd) {
+    while (!_cmds.push(cmd)) {
+      std::this_thread::yield();
+    }
+    _event.notify();
+  }
+
+  uint32_t drain(uint64_t &sum) {
+    uint32_t key = _event.prepare_wait();
+    if (_cmds.empty()) {
+      _event.wait_until(key, std::chrono::steady_clock::now() +
+                                 std::chrono::milliseconds(500));
+    } else {
+      _event.cancel_wait();
+    }
+    uint32_t n = 0;
+    bench_cmd_t cmd;
+    for (; _cmds.pop(cmd); n++) sum += cmd.seq;
+    return n;
+  }
+};
+
+template <typename Queue>
+static uint32_t run_cmd_queue(Queue &queue, uint32_t producers,
+                              uint32_t count) {
+  const uint64_t total = (uint64_t)producers * count;
+  uint64_t received = 0, sum = 0;
+
+  auto t0 = std::chrono::steady_clock::now();
+  pooled_thread consumer([&]() {
+    while (received < total) received += queue.drain(sum);
+  });
+  if (!consumer.joinable()) return 0;
+
+  std::vector<pooled_thread> threads;
+  for (uint32_t p = 0; p < producers; p++) {
+    threads.emplace_back([&queue, p, count]() {
+      for (uint32_t i = 0; i < count; i++) queue.send(bench_cmd_t{p, i});
+    });
+    if (!threads.back().joinable()) {
+      // lets the consumer finish with what the others send
+      for (uint32_t i = 0; i < count; i++) queue.send(bench_cmd_t{p, i});
+    }
+  }
+  for (auto &t : threads) t.join();
+  consumer.join();
+  auto elapsed = std::chrono::steady_clock::now() - t0;
+
+  if (sum != total * (count - 1) / 2) {
+    LOG_ERROR("<bench> command queue checksum mismatch");
+    return 0;
+  }
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed);
+  return us.count() > 0 ? (uint32_t)us.count() : 1;
+}
+
+// 'producers' wasi threads each send 'count' commands to one consumer
+// thread. Returns the microseconds until the consumer took the last one,
+// 0 if a thread could not be started or a command got lost.
+uint32_t WASM_EXPORT(bench_cmd_queue)(uint32_t producers, uint32_t count,
+                                      uint32_t kind) {
+  if (!producers || !count) return 0;
+
+  switch (kind) {
+  case bench_queue_mutex:
+  case bench_queue_try_lock: {
+    bench_deque_queue queue(kind == bench_queue_try_lock);
+    return run_cmd_queue(queue, producers, count);
+  }
+  case bench_queue_ring: {
+    // its cells are too large for the stack
+    std::unique_ptr<bench_ring_queue> queue(new bench_ring_queue());
+    return run_cmd_queue(*queue, producers, count);
+  }
+  default:
+    return 0;
+  }
+}
+
+// 'count' TRACE lines with one argument each
+void WASM_EXPORT(bench_trace)(uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    TRACE("bench trace %u", i);
+  }
+}
+
+// Two repeating timers expiring in the same tick, each of whose callbacks
+// stops both: only the first to run may fire. Returns how many fires
+// there were over 'periods' periods. Needs callbacks on the timer thread
+// (no workers), where their commands run inline.
+static timer_handle_t batch_timers[2] = {TIMER_INITIALIZER, TIMER_INITIALIZER};
+static std::atomic<uint32_t> batch_fires = {0};
+
+static void batch_timer_func(timer_handle_t *) {
+  batch_fires++;
+  timer_queue::instance().stop_timer(&batch_timers[0]);
+  timer_queue::instance().stop_timer(&batch_timers[1]);
+}
+
+uint32_t WASM_EXPORT(bench_stop_in_batch)(uint32_t periods) {
+  const unsigned period_ms = 10;
+  auto &tim = timer_queue::instance();
+  timer_handle_t *timers[2];
+  for (unsigned i = 0; i < 2; i++) {
+    tim.create_timer(&batch_timers[i], batch_timer_func, "batch timer",
+                     period_ms, true);
+    timers[i] = &batch_timers[i];
+  }
+
+  batch_fires = 0;
+  // one command: both get the same expiry
+  tim.start_timers(timers, 2);
+  std::this_thread::sleep_for(std::chrono::milliseconds(periods * period_ms));
+  tim.stop_timers(timers, 2);
+  return batch_fires;
+}
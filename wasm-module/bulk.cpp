@@ -0,0 +1,69 @@
+#include "bulk.h"
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+void bulk_add_u32(uint32_t *totals, const uint32_t *values, size_t count) {
+  size_t i = 0;
+#if defined(__wasm_simd128__)
+  for (; i + 4 <= count; i += 4) {
+    v128_t sum = wasm_i32x4_add(wasm_v128_load(totals + i),
+                                wasm_v128_load(values + i));
+    wasm_v128_store(totals + i, sum);
+  }
+#endif
+  for (; i < count; i++) {
+    totals[i] += values[i];
+  }
+}
+
+void timer_hist_merge(timer_histogram_t &dst, const timer_histogram_t &src) {
+  bulk_add_u32(dst.buckets, src.buckets, TIMER_HIST_BUCKETS);
+  dst.count += src.count;
+  if (src.max > dst.max) dst.max = src.max;
+}
+
+void timer_stats_merge(timer_stats_t &dst, const timer_stats_t &src) {
+  timer_hist_merge(dst.fire_delay_us, src.fire_delay_us);
+  timer_hist_merge(dst.callback_us, src.callback_us);
+  timer_hist_merge(dst.cmds_per_wakeup, src.cmds_per_wakeup);
+  timer_hist_merge(dst.deferred_delay_us, src.deferred_delay_us);
+  dst.wakeups += src.wakeups;
+  dst.active_timers += src.active_timers;
+  if (src.active_timers_max > dst.active_timers_max) {
+    dst.active_timers_max = src.active_timers_max;
+  }
+  dst.missed_deadlines += src.missed_deadlines;
+  dst.timer_cpu_us += src.timer_cpu_us;
+}
+
+void timer_batch_pack(timer_batch_entry_t *entries,
+                      timer_handle_t *const *timers, const unsigned *periods,
+                      size_t count) {
+  size_t i = 0;
+#if defined(__wasm_simd128__)
+  static_assert(sizeof(timer_batch_entry_t) == 2 * sizeof(uint32_t) &&
+                    sizeof(timer_handle_t *) == sizeof(uint32_t),
+                "wasm32 batch entries are (handle, period) pairs");
+  auto out = reinterpret_cast<uint32_t *>(entries);
+  for (; i + 4 <= count; i += 4) {
+    v128_t t = wasm_v128_load(timers + i);
+    v128_t p = periods ? wasm_v128_load(periods + i) : wasm_i32x4_splat(0);
+    wasm_v128_store(out + 2 * i, wasm_i32x4_shuffle(t, p, 0, 4, 1, 5));
+    wasm_v128_store(out + 2 * i + 4, wasm_i32x4_shuffle(t, p, 2, 6, 3, 7));
+  }
+#endif
+  for (; i < count; i++) {
+    entries[i].timer = timers[i];
+    entries[i].period = periods ? periods[i] : 0;
+  }
+}
+
+bool bulk_simd() {
+#if defined(__wasm_simd128__)
+  return true;
+#else
+  return false;
+#endif
+}
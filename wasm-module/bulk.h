@@ -0,0 +1,30 @@
+// bulk.h - array kernels of the module's bulk paths
+//
+// Vectorized with simd128 when the module is built with SIMD=ON, plain
+// loops otherwise. Results are identical either way.
+#ifndef BULK_H
+#define BULK_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "timer.h"
+#include "timer_stats.h"
+
+// totals[i] += values[i]
+void bulk_add_u32(uint32_t *totals, const uint32_t *values, size_t count);
+
+// Adds 'src' to 'dst'; not atomic, 'src' should be a snapshot.
+void timer_hist_merge(timer_histogram_t &dst, const timer_histogram_t &src);
+void timer_stats_merge(timer_stats_t &dst, const timer_stats_t &src);
+
+// Interleaves handles and periods into batch entries; null 'periods'
+// means 0.
+void timer_batch_pack(timer_batch_entry_t *entries,
+                      timer_handle_t *const *timers, const unsigned *periods,
+                      size_t count);
+
+// Whether the kernels above use simd128
+bool bulk_simd();
+
+#endif // BULK_H
@@ -0,0 +1,59 @@
+// counter_region.h - seqlock-protected counters in linear memory
+//
+// Shared with the host, which takes snapshots with plain memory reads
+// instead of calling into the module: only 32-bit fields, accessed with
+// atomics. 'seq' is odd while a writer updates the values; writers from
+// several module threads serialize on it.
+#ifndef COUNTER_REGION_H
+#define COUNTER_REGION_H
+
+#include <cstdint>
+
+#define COUNTER_REGION_MAX 16
+
+struct counter_region_t {
+  uint32_t seq;
+  uint32_t count;  // values in use, fixed at build time
+  uint32_t values[COUNTER_REGION_MAX];
+};
+
+// any module thread
+inline void counter_region_add(counter_region_t &r, uint32_t index,
+                               uint32_t n) {
+  uint32_t seq = __atomic_load_n(&r.seq, __ATOMIC_RELAXED);
+  while ((seq & 1) ||
+         !__atomic_compare_exchange_n(&r.seq, &seq, seq + 1, true,
+                                      __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+    seq = __atomic_load_n(&r.seq, __ATOMIC_RELAXED);
+  }
+  // values are not published before 'seq' is odd
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  uint32_t value = __atomic_load_n(&r.values[index], __ATOMIC_RELAXED);
+  __atomic_store_n(&r.values[index], value + n, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&r.seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+// Copies a consistent snapshot of up to 'max' values and returns their
+// number, or -1 if every attempt raced with a writer.
+inline int counter_region_read(const counter_region_t &r, uint32_t *values,
+                               uint32_t max, unsigned attempts = 1000) {
+  uint32_t count = __atomic_load_n(&r.count, __ATOMIC_RELAXED);
+  if (count > COUNTER_REGION_MAX) count = COUNTER_REGION_MAX;
+  if (count > max) count = max;
+
+  while (attempts--) {
+    uint32_t seq = __atomic_load_n(&r.seq, __ATOMIC_ACQUIRE);
+    if (seq & 1) continue;
+
+    for (uint32_t i = 0; i < count; i++) {
+      values[i] = __atomic_load_n(&r.values[i], __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&r.seq, __ATOMIC_RELAXED) == seq) return count;
+  }
+  return -1;
+}
+
+#endif // COUNTER_REGION_H
@@ -0,0 +1,119 @@
+#include "deferred.h"
+#include "log.h"
+
+using deferred_clock = std::chrono::steady_clock;
+
+// set on the executor thread
+static thread_local deferred_executor* _current_executor = nullptr;
+
+deferred_executor::~deferred_executor() {
+  stop();
+}
+
+void deferred_executor::start()
+{
+  if (!_started.exchange(true)) {
+    _running = true;
+    _thread = pooled_thread([&]() { main_loop(); });
+    if (!_thread.joinable()) {
+      // queued calls wait for the next post to try again
+      LOG_ERROR("<deferred> no executor thread");
+      _running = false;
+      _started = false;
+    }
+  }
+}
+
+void deferred_executor::stop()
+{
+  if (_running.exchange(false)) {
+    _event.notify();
+  }
+  _thread.join();
+}
+
+bool deferred_executor::try_post(deferred_func_t func, void *param1,
+                                 uint32_t param2, deferred_priority prio,
+                                 deferred_completion *completion)
+{
+  if (!func) return false;
+
+  deferred_call_t call{func, param1, param2, completion, deferred_clock::now()};
+  if (!_queues[(int)prio].push(call)) {
+    return false;
+  }
+
+  start();
+  _event.notify();
+  return true;
+}
+
+void deferred_executor::post(deferred_func_t func, void *param1,
+                             uint32_t param2, deferred_priority prio,
+                             deferred_completion *completion)
+{
+  if (!func) return;
+
+  while (!try_post(func, param1, param2, prio, completion)) {
+    if (_current_executor == this) {
+      // nobody else would drain the queue
+      func(param1, param2);
+      if (completion) completion->signal();
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+size_t deferred_executor::run_batch(deferred_priority prio, size_t max)
+{
+  auto &queue = _queues[(int)prio];
+  auto &high = _queues[(int)deferred_priority::high];
+  deferred_call_t call;
+  size_t n = 0;
+  for (; n < max && queue.pop(call); n++) {
+    if (_delay_us) {
+      auto delay = std::chrono::duration_cast<std::chrono::microseconds>(
+          deferred_clock::now() - call.queued);
+      timer_hist_record(*_delay_us, (uint32_t)delay.count());
+    }
+    call.func(call.param1, call.param2);
+    if (call.completion) call.completion->signal();
+
+    // high priority calls preempt the rest of a normal batch
+    if (prio != deferred_priority::high && !high.empty()) {
+      n++;
+      break;
+    }
+  }
+  return n;
+}
+
+void deferred_executor::main_loop()
+{
+  _current_executor = this;
+
+  auto &high = _queues[(int)deferred_priority::high];
+  auto &normal = _queues[(int)deferred_priority::normal];
+
+  TRACE("<deferred_executor> started");
+  while (true) {
+    size_t n = run_batch(deferred_priority::high, DEFERRED_QUEUE_SIZE);
+    n += run_batch(deferred_priority::normal, DEFERRED_BATCH_SIZE);
+    if (n) continue;
+
+    uint32_t key = _event.prepare_wait();
+    if (!high.empty() || !normal.empty()) {
+      _event.cancel_wait();
+    } else if (!_running) {
+      // queues drained: no completion is left pending
+      _event.cancel_wait();
+      break;
+    } else {
+      _event.wait(key);
+    }
+  }
+  // the thread goes back to the pool
+  _current_executor = nullptr;
+  TRACE("<deferred_executor> stopped");
+}
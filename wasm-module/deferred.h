@@ -0,0 +1,115 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "mpsc_ring.h"
+#include "thread_pool.h"
+#include "timer_stats.h"
+#include "wakeup.h"
+
+typedef void (*deferred_func_t)(void*, uint32_t);
+
+enum class deferred_priority {
+  high,
+  normal,
+};
+
+// Signalled by the executor once the call it was attached to has run.
+// Must outlive that call; may be reused after 'wait()' returns.
+class deferred_completion {
+  std::atomic<bool> _done = {false};
+  // set while 'signal()' still touches '_event'
+  std::atomic<bool> _signalling = {false};
+  wakeup_event _event;
+
+public:
+  void reset() { _done = false; }
+  bool done() const { return _done && !_signalling; }
+
+  void wait() {
+    while (!_done) {
+      uint32_t key = _event.prepare_wait();
+      if (_done) {
+        _event.cancel_wait();
+        break;
+      }
+      _event.wait(key);
+    }
+    while (_signalling) {
+      std::this_thread::yield();
+    }
+  }
+
+  // executor thread
+  void signal() {
+    _signalling = true;
+    _done = true;
+    _event.notify_all();
+    _signalling = false;
+  }
+};
+
+struct deferred_call_t {
+  deferred_func_t func;
+  void *param1;
+  uint32_t param2;
+  deferred_completion *completion;
+  std::chrono::steady_clock::time_point queued;
+};
+
+// per priority
+#define DEFERRED_QUEUE_SIZE 256
+
+// normal priority calls run per batch; a queued high priority call ends
+// the batch early
+#define DEFERRED_BATCH_SIZE 32
+
+// Runs deferred calls on a dedicated thread, independently of timer
+// expiry. High priority calls always go first; each wakeup drains the
+// queues in batches.
+class deferred_executor {
+  pooled_thread _thread;
+  std::atomic<bool> _started = {false};
+  std::atomic<bool> _running = {false};
+
+  mpsc_ring<deferred_call_t, DEFERRED_QUEUE_SIZE> _queues[2];
+  wakeup_event _event;
+
+  // queued -> started, optional
+  timer_histogram_t *_delay_us;
+
+  size_t run_batch(deferred_priority prio, size_t max);
+  void main_loop();
+
+public:
+  explicit deferred_executor(timer_histogram_t *delay_us = nullptr)
+      : _delay_us(delay_us) {}
+  ~deferred_executor();
+
+  deferred_executor(deferred_executor const &) = delete;
+  void operator=(deferred_executor const &) = delete;
+
+  // The thread is started on first use, and not restarted once stopped.
+  void start();
+
+  // Runs what is already queued, then joins the thread.
+  void stop();
+
+  // Waits while the queue is full; from the executor thread itself, a
+  // call that does not fit runs inline.
+  void post(deferred_func_t func, void *param1, uint32_t param2,
+            deferred_priority prio = deferred_priority::normal,
+            deferred_completion *completion = nullptr);
+
+  // Fails instead of waiting when the queue is full.
+  bool try_post(deferred_func_t func, void *param1, uint32_t param2,
+                deferred_priority prio = deferred_priority::normal,
+                deferred_completion *completion = nullptr);
+};
+
+#endif // DEFERRED_H
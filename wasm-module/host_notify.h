@@ -0,0 +1,15 @@
+// host_notify.h - notifications to the host
+#ifndef HOST_NOTIFY_H
+#define HOST_NOTIFY_H
+
+#include "imp_export.h"
+
+// The timer queue has fully stopped: its thread, workers and deferred
+// executor are done, and the next 'async_cleanup' call completes.
+void WASM_IMPORT(_host_queue_stopped)();
+
+// A module thread is about to exit, taking its runtime instance with it:
+// the host's last chance to read that instance's profiling counters.
+void WASM_IMPORT(_host_thread_exit)();
+
+#endif // HOST_NOTIFY_H
@@ -0,0 +1,15 @@
+// host_timer.h - host timer imports for TIMER_HOST_DRIVEN builds
+#ifndef HOST_TIMER_H
+#define HOST_TIMER_H
+
+#include "imp_export.h"
+
+#include <cstdint>
+
+#define TIMER_HOST_DISARM UINT32_MAX
+
+// (Re)arms this instance's host timer to call the 'timer_host_poll' export
+// in 'delay_us' (0: as soon as possible), or disarms it.
+void WASM_IMPORT(_host_timer_arm)(uint32_t delay_us);
+
+#endif // HOST_TIMER_H
@@ -0,0 +1,15 @@
+#include "log.h"
+
+#include <chrono>
+
+static log_ring_t _log_ring = {LOG_RING_RECORDS, 0, 0, 0, LOG_LEVEL_INFO, {}};
+
+log_ring_t *log_ring() { return &_log_ring; }
+
+void _log_write(uint32_t level, const char *fmt, const char *buf, int len)
+{
+  auto now = std::chrono::steady_clock::now().time_since_epoch();
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(now);
+  log_ring_write(_log_ring, level, (uint32_t)(uintptr_t)fmt, buf,
+                 len > 0 ? len : 0, us.count());
+}
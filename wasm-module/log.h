@@ -3,21 +3,135 @@
 #define LOG_H
 
 #include "imp_export.h"
+#include "log_ring.h"
 
-#define TRACE(fmt, ...) \
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+// length actually written by snprintf() into a 'size' bytes buffer
+#define LOG_LEN(n, size) \
+    ((n) < 0 ? 0 : (n) < (int)(size) ? (n) : (int)(size) - 1)
+
+// Records are queued to the log ring, drained by the host without a call
+// per line, and dropped before any work if 'level' is filtered out.
+//
+// By default only the format string's address and the raw arguments are
+// recorded: the host formats them. LOG_TEXT formats them here instead.
+#define LOG(level, fmt, ...) \
     do { \
-        char __buffer[256]; \
-        snprintf(__buffer, sizeof(__buffer), fmt, ##__VA_ARGS__); \
-        _log_func(__buffer, sizeof(__buffer)); \
+        if (log_enabled(level)) { \
+            if (0) _log_check_format(fmt, ##__VA_ARGS__); \
+            _log_record(level, fmt, ##__VA_ARGS__); \
+        } \
     } while(0)
 
+#define LOG_ERROR(fmt, ...) LOG(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_WARN(fmt, ...) LOG(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...) LOG(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...) LOG(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+
+#define TRACE(fmt, ...) LOG_INFO(fmt, ##__VA_ARGS__)
+
+// Synchronous: for messages that must get out before the module dies.
 #define TRACE_VA(fmt, args) \
     do { \
         char __buffer[256]; \
-        vsnprintf(__buffer, sizeof(__buffer), fmt, args); \
-        _log_func(__buffer, sizeof(__buffer)); \
+        int __len = vsnprintf(__buffer, sizeof(__buffer), fmt, args); \
+        _log_func(__buffer, LOG_LEN(__len, sizeof(__buffer))); \
     } while(0)
 
 void WASM_IMPORT(_log_func)(const char* buf, int buf_len);
 
+// exported to the host as 'get_log_ring'
+log_ring_t *log_ring();
+
+inline bool log_enabled(uint32_t level) {
+  return log_ring_enabled(*log_ring(), level);
+}
+
+void _log_write(uint32_t level, const char *fmt, const char *buf, int len);
+
+// never called: lets the compiler check LOG() arguments against 'fmt'
+__attribute__((format(printf, 1, 2)))
+inline void _log_check_format(const char *, ...) {}
+
+// Appends tagged arguments; 'full' once one did not fit.
+class log_args_writer {
+  char _buf[LOG_RECORD_TEXT];
+  size_t _len = 0;
+  bool _full = false;
+
+  bool put(char tag, const void *value, size_t size) {
+    if (_full || _len + 1 + size > sizeof(_buf)) {
+      _full = true;
+      return false;
+    }
+    _buf[_len++] = tag;
+    memcpy(&_buf[_len], value, size);
+    _len += size;
+    return true;
+  }
+
+public:
+  const char *data() const { return _buf; }
+  size_t size() const { return _len; }
+
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value ||
+                          std::is_enum<T>::value>::type
+  add(T value) {
+    if (sizeof(T) <= 4) {
+      uint32_t v = (uint32_t)value;
+      put(LOG_ARG_I32, &v, sizeof(v));
+    } else {
+      uint64_t v = (uint64_t)value;
+      put(LOG_ARG_I64, &v, sizeof(v));
+    }
+  }
+
+  void add(double value) { put(LOG_ARG_DOUBLE, &value, sizeof(value)); }
+
+  void add(const char *str) {
+    if (!str) str = "(null)";
+    size_t room = sizeof(_buf) - _len;
+    if (_full || room < 4) {
+      _full = true;
+      return;
+    }
+    // truncated, leaving room for the arguments that follow
+    size_t max = room - 3 < LOG_RECORD_TEXT / 2 ? room - 3 : LOG_RECORD_TEXT / 2;
+    uint16_t n = strnlen(str, max);
+    put(LOG_ARG_STR, &n, sizeof(n));
+    memcpy(&_buf[_len], str, n);
+    _len += n;
+  }
+
+  void add(const void *ptr) {
+    uint32_t v = (uint32_t)(uintptr_t)ptr;
+    put(LOG_ARG_PTR, &v, sizeof(v));
+  }
+
+  void add_all() {}
+
+  template <typename T, typename... Args>
+  void add_all(T first, Args... rest) {
+    add(first);
+    add_all(rest...);
+  }
+};
+
+template <typename... Args>
+inline void _log_record(uint32_t level, const char *fmt, Args... args) {
+#if defined(LOG_TEXT)
+  char buf[LOG_RECORD_TEXT];
+  int len = snprintf(buf, sizeof(buf), fmt, args...);
+  _log_write(level, nullptr, buf, LOG_LEN(len, sizeof(buf)));
+#else
+  log_args_writer w;
+  w.add_all(args...);
+  _log_write(level, fmt, w.data(), w.size());
+#endif
+}
+
 #endif // LOG_H
@@ -0,0 +1,113 @@
+// log_ring.h - lock-free log record ring in linear memory
+//
+// Shared with the host, which drains it without calling into the module:
+// only 32-bit fields, and every index is accessed with atomics. Producers
+// are module threads (Vyukov's bounded MPSC protocol), the consumer is the
+// host drain thread. A full ring drops records rather than blocking.
+#ifndef LOG_RING_H
+#define LOG_RING_H
+
+#include <cstdint>
+#include <cstring>
+
+#define LOG_RING_RECORDS 128
+#define LOG_RECORD_TEXT 232
+
+enum module_log_level_t {
+  LOG_LEVEL_ERROR,
+  LOG_LEVEL_WARN,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_DEBUG,
+};
+
+// Argument tags of binary records: each is followed by its raw value,
+// 's' by a 16-bit length and the string bytes.
+#define LOG_ARG_I32 'i'
+#define LOG_ARG_I64 'I'
+#define LOG_ARG_DOUBLE 'd'
+#define LOG_ARG_STR 's'
+#define LOG_ARG_PTR 'p'
+
+static_assert((LOG_RING_RECORDS & (LOG_RING_RECORDS - 1)) == 0,
+              "record count must be a power of 2");
+
+struct log_record_t {
+  // offset from the record index, so that a zeroed ring is ready to use
+  uint32_t seq;
+  uint32_t len;
+  // steady clock, i.e. CLOCK_MONOTONIC on both sides
+  uint32_t time_us_lo;
+  uint32_t time_us_hi;
+  uint32_t level;
+  // 0: 'text' is the formatted line; otherwise the address of the format
+  // string in linear memory, and 'text' holds its tagged arguments
+  uint32_t fmt;
+  char text[LOG_RECORD_TEXT];
+};
+
+struct log_ring_t {
+  uint32_t records;  // LOG_RING_RECORDS, checked by the host
+  uint32_t head;     // producers
+  uint32_t tail;     // consumer
+  uint32_t dropped;
+  // most verbose level recorded, set by the host at any time
+  uint32_t level;
+  log_record_t ring[LOG_RING_RECORDS];
+};
+
+inline uint32_t log_record_seq(const log_ring_t &r, uint32_t pos) {
+  uint32_t index = pos & (LOG_RING_RECORDS - 1);
+  return __atomic_load_n(&r.ring[index].seq, __ATOMIC_ACQUIRE) + index;
+}
+
+inline void log_record_set_seq(log_ring_t &r, uint32_t pos, uint32_t seq) {
+  uint32_t index = pos & (LOG_RING_RECORDS - 1);
+  __atomic_store_n(&r.ring[index].seq, seq - index, __ATOMIC_RELEASE);
+}
+
+inline bool log_ring_enabled(const log_ring_t &r, uint32_t level) {
+  return level <= __atomic_load_n(&r.level, __ATOMIC_RELAXED);
+}
+
+// any module thread; 'len' is truncated to LOG_RECORD_TEXT
+inline bool log_ring_write(log_ring_t &r, uint32_t level, uint32_t fmt,
+                           const char *text, uint32_t len, uint64_t time_us) {
+  uint32_t pos = __atomic_load_n(&r.head, __ATOMIC_RELAXED);
+  while (true) {
+    int32_t diff = (int32_t)(log_record_seq(r, pos) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r.head, &pos, pos + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (diff < 0) {
+      __atomic_fetch_add(&r.dropped, 1, __ATOMIC_RELAXED);
+      return false;
+    } else {
+      pos = __atomic_load_n(&r.head, __ATOMIC_RELAXED);
+    }
+  }
+
+  log_record_t &rec = r.ring[pos & (LOG_RING_RECORDS - 1)];
+  rec.len = len < LOG_RECORD_TEXT ? len : LOG_RECORD_TEXT;
+  rec.time_us_lo = (uint32_t)time_us;
+  rec.time_us_hi = (uint32_t)(time_us >> 32);
+  rec.level = level;
+  rec.fmt = fmt;
+  memcpy(rec.text, text, rec.len);
+  log_record_set_seq(r, pos, pos + 1);
+  return true;
+}
+
+// host drain thread only
+inline bool log_ring_read(log_ring_t &r, log_record_t &out) {
+  uint32_t pos = __atomic_load_n(&r.tail, __ATOMIC_RELAXED);
+  if ((int32_t)(log_record_seq(r, pos) - (pos + 1)) < 0) return false;
+
+  out = r.ring[pos & (LOG_RING_RECORDS - 1)];
+  log_record_set_seq(r, pos, pos + LOG_RING_RECORDS);
+  __atomic_store_n(&r.tail, pos + 1, __ATOMIC_RELAXED);
+  return true;
+}
+
+#endif // LOG_RING_H
@@ -0,0 +1,122 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE  // pthread_getattr_np()
+#endif
+
+#include "mem_usage.h"
+
+#include <pthread.h>
+#include <unistd.h>
+
+// linker symbols: the main stack lies between data and heap
+extern char __data_end;
+extern char __heap_base;
+
+static mem_usage_t _usage;
+
+static thread_local int _slot = -1;
+
+// stays clear of the caller's own frame
+#define MEM_USAGE_STACK_MARGIN 256
+
+static void paint(uintptr_t low, uintptr_t high)
+{
+  low = (low + 3) & ~(uintptr_t)3;
+  for (auto p = (uint32_t *)low; (uintptr_t)(p + 1) <= high; p++) {
+    *p = MEM_USAGE_PATTERN;
+  }
+}
+
+static uint32_t scan(const mem_usage_thread_t &t)
+{
+  auto p = (const uint32_t *)(uintptr_t)t.stack_low;
+  uint32_t words = t.stack_size / sizeof(uint32_t);
+  uint32_t unused = 0;
+  while (unused < words &&
+         __atomic_load_n(&p[unused], __ATOMIC_RELAXED) == MEM_USAGE_PATTERN) {
+    unused++;
+  }
+  return t.stack_size - unused * sizeof(uint32_t);
+}
+
+static void update_peak(mem_usage_thread_t &t)
+{
+  uint32_t peak = scan(t);
+  uint32_t prev = __atomic_load_n(&t.stack_peak, __ATOMIC_RELAXED);
+  while (peak > prev &&
+         !__atomic_compare_exchange_n(&t.stack_peak, &prev, peak, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+// Paints the calling thread's stack below its current frame
+static int add_stack(uintptr_t low, uintptr_t size)
+{
+  uint32_t slot = __atomic_fetch_add(&_usage.threads, 1, __ATOMIC_RELAXED);
+  if (slot >= MEM_USAGE_THREADS) {
+    __atomic_store_n(&_usage.threads, MEM_USAGE_THREADS, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&_usage.threads_dropped, 1, __ATOMIC_RELAXED);
+    return -1;
+  }
+
+  char frame;
+  paint(low, (uintptr_t)&frame - MEM_USAGE_STACK_MARGIN);
+
+  mem_usage_thread_t &t = _usage.thread[slot];
+  t.stack_low = low;
+  t.stack_size = size;
+  t.stack_peak = 0;
+  __atomic_store_n(&t.running, 1, __ATOMIC_RELEASE);
+  return slot;
+}
+
+void mem_usage_thread_begin()
+{
+  // pooled threads begin once per function they run
+  if (_slot >= 0) return;
+  if (!__atomic_load_n(&_usage.enabled, __ATOMIC_ACQUIRE)) return;
+
+  pthread_attr_t attr;
+  void *addr;
+  size_t size;
+  if (pthread_getattr_np(pthread_self(), &attr) != 0) return;
+  int ret = pthread_attr_getstack(&attr, &addr, &size);
+  pthread_attr_destroy(&attr);
+  if (ret != 0) return;
+
+  _slot = add_stack((uintptr_t)addr, size);
+}
+
+void mem_usage_thread_end()
+{
+  if (_slot < 0) return;
+
+  mem_usage_thread_t &t = _usage.thread[_slot];
+  update_peak(t);
+  // the stack is freed next
+  __atomic_store_n(&t.running, 0, __ATOMIC_RELEASE);
+  _slot = -1;
+}
+
+const mem_usage_t *mem_usage_update()
+{
+  if (!__atomic_exchange_n(&_usage.enabled, 1, __ATOMIC_ACQ_REL)) {
+    _usage.heap_base = (uint32_t)(uintptr_t)&__heap_base;
+
+    // only from the host's main exec env, which runs on the main stack
+    char frame;
+    uintptr_t low = (uintptr_t)&__data_end;
+    uintptr_t high = (uintptr_t)&__heap_base;
+    if ((uintptr_t)&frame > low && (uintptr_t)&frame < high) {
+      add_stack(low, high - low);
+    }
+  }
+
+  uint32_t threads = __atomic_load_n(&_usage.threads, __ATOMIC_RELAXED);
+  for (uint32_t i = 0; i < threads; i++) {
+    mem_usage_thread_t &t = _usage.thread[i];
+    if (__atomic_load_n(&t.running, __ATOMIC_ACQUIRE)) update_peak(t);
+  }
+
+  _usage.heap_end = (uint32_t)(uintptr_t)sbrk(0);
+  return &_usage;
+}
@@ -0,0 +1,40 @@
+// mem_usage.h - module memory usage, for the host's memory profile
+//
+// Shared with the host: only 32-bit fields. Thread stacks are painted
+// once profiling is enabled, and their high-water mark is the lowest
+// address no longer holding the pattern.
+#ifndef MEM_USAGE_H
+#define MEM_USAGE_H
+
+#include <cstdint>
+
+#define MEM_USAGE_THREADS 16
+#define MEM_USAGE_PATTERN 0xa5a5a5a5u
+
+struct mem_usage_thread_t {
+  uint32_t stack_low;  // lowest stack address
+  uint32_t stack_size;
+  uint32_t stack_peak;  // bytes used at most
+  uint32_t running;
+};
+
+struct mem_usage_t {
+  uint32_t enabled;
+  uint32_t heap_base;
+  // sbrk(0): malloc never gives memory back, so this is also its peak
+  uint32_t heap_end;
+  uint32_t threads;  // slots in use, the main stack first
+  uint32_t threads_dropped;
+  mem_usage_thread_t thread[MEM_USAGE_THREADS];
+};
+
+// Bracket a module thread's body; no-ops until profiling is enabled, and
+// begin is a no-op on threads already profiled.
+void mem_usage_thread_begin();
+void mem_usage_thread_end();
+
+// First call enables profiling and paints the main stack; each call
+// refreshes the figures of running threads.
+const mem_usage_t *mem_usage_update();
+
+#endif // MEM_USAGE_H
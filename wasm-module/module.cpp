@@ -1,15 +1,36 @@
+#include "bulk.h"
+#include "counter_region.h"
 #include "imp_export.h"
 #include "log.h"
+#include "mem_usage.h"
+#include "thread_pool.h"
 #include "timer.h"
 
+#include <cstdlib>
+#include <vector>
+
 timer_handle_t t1 = TIMER_INITIALIZER;
 timer_handle_t t2 = TIMER_INITIALIZER;
 
-uint32_t counters[2] = {0};
+// t1, t2, then every dynamically allocated timer
+static counter_region_t counters = {0, 3, {0}};
+
+static void dynamic_timer_func(timer_handle_t *) {
+  counter_region_add(counters, 2, 1);
+}
+
+// stale or unknown IDs resolve to null and are skipped by the batch
+static void resolve_timer_ids(const uint32_t *ids, uint32_t count,
+                              std::vector<timer_handle_t*> &timers) {
+  timers.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    timers[i] = timer_get(ids[i]);
+  }
+}
 
 void timer_func(timer_handle_t *h, int idx) {
   TRACE("%s expired", h->name);
-  counters[idx]++;
+  counter_region_add(counters, idx, 1);
 }
 
 void timer_func1(timer_handle_t *h) { timer_func(h, 0); }
@@ -20,10 +41,53 @@ const char* WASM_EXPORT(get_module_name)() {
 }
 
 void WASM_EXPORT(get_counters)(uint32_t** p_counters, size_t* len) {
-  TRACE("counters[0] = %u", counters[0]);
-  TRACE("counters[1] = %u", counters[1]);
-  *p_counters = counters;
-  *len = sizeof(counters) / sizeof(uint32_t);
+  TRACE("counters[0] = %u", counters.values[0]);
+  TRACE("counters[1] = %u", counters.values[1]);
+  TRACE("counters[2] = %u", counters.values[2]);
+  *p_counters = counters.values;
+  *len = counters.count;
+}
+
+// read by the host without further calls
+const counter_region_t* WASM_EXPORT(get_counter_region)() {
+  return &counters;
+}
+
+const log_ring_t* WASM_EXPORT(get_log_ring)() {
+  return log_ring();
+}
+
+// the first call enables stack profiling
+const mem_usage_t* WASM_EXPORT(get_mem_usage)() {
+  return mem_usage_update();
+}
+
+const timer_stats_t* WASM_EXPORT(get_timer_stats)() {
+  return &timer_queue::stats();
+}
+
+// Adds the module's timer stats to '*totals', e.g. to aggregate samples
+// taken over time.
+void WASM_EXPORT(merge_timer_stats)(timer_stats_t *totals) {
+  timer_stats_merge(*totals, timer_queue::stats());
+}
+
+// totals[i] += values[i]
+void WASM_EXPORT(sum_counters)(uint32_t *totals, const uint32_t *values,
+                               uint32_t count) {
+  bulk_add_u32(totals, values, count);
+}
+
+// Packs 'count' handles and periods into 'entries' the way batch commands
+// do, without sending them.
+void WASM_EXPORT(pack_timer_batch)(timer_batch_entry_t *entries,
+                                   timer_handle_t *const *timers,
+                                   const uint32_t *periods, uint32_t count) {
+  timer_batch_pack(entries, timers, periods, count);
+}
+
+bool WASM_EXPORT(get_module_simd)() {
+  return bulk_simd();
 }
 
 void WASM_EXPORT(create_timers)() {
@@ -32,32 +96,118 @@ void WASM_EXPORT(create_timers)() {
   tim.create_timer(&t2, timer_func2, "timer 2", 500, true);
 }
 
+// Allocates up to 'count' repeating timers, each allowed to fire up to
+// 'slack' ms late, and writes their IDs to 'ids'. Returns how many were
+// allocated: fewer than 'count' once the timer slab is exhausted.
+uint32_t WASM_EXPORT(create_timers_batch)(uint32_t *ids, uint32_t count,
+                                          uint32_t period, uint32_t slack) {
+  uint32_t n = 0;
+  for (; n < count; n++) {
+    ids[n] = timer_alloc(dynamic_timer_func, "dynamic timer", period, true,
+                         slack);
+    if (ids[n] == TIMER_INVALID_ID) break;
+  }
+  TRACE("allocated %u/%u timers", n, count);
+  return n;
+}
+
+void WASM_EXPORT(destroy_timers_batch)(const uint32_t *ids, uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    timer_destroy(ids[i]);
+  }
+}
+
+void WASM_EXPORT(start_timers_batch)(const uint32_t *ids, uint32_t count) {
+  std::vector<timer_handle_t*> timers;
+  resolve_timer_ids(ids, count, timers);
+  timer_queue::instance().start_timers(timers.data(), count);
+}
+
+void WASM_EXPORT(stop_timers_batch)(const uint32_t *ids, uint32_t count) {
+  std::vector<timer_handle_t*> timers;
+  resolve_timer_ids(ids, count, timers);
+  timer_queue::instance().stop_timers(timers.data(), count);
+}
+
+// Sets the periods of the given timers and (re)starts them.
+void WASM_EXPORT(set_timer_periods_batch)(const uint32_t *ids,
+                                          const uint32_t *periods,
+                                          uint32_t count) {
+  std::vector<timer_handle_t*> timers;
+  resolve_timer_ids(ids, count, timers);
+  timer_queue::instance().set_timer_periods(timers.data(), periods, count);
+}
+
+void WASM_EXPORT(start_timer_workers)(uint32_t count) {
+  TRACE("starting %u timer workers", count);
+  timer_queue::instance().start_workers(count);
+}
+
+// pthread stack size of module threads spawned from now on, 0 for the
+// libc default
+void WASM_EXPORT(set_thread_stack_size)(uint32_t size) {
+  thread_pool::instance().set_stack_size(size);
+}
+
+// Spawns module threads until 'count' are parked, ready for the timer
+// thread, its workers and the pend_function() executor. Returns how many
+// are parked.
+uint32_t WASM_EXPORT(prewarm_threads)(uint32_t count) {
+  uint32_t parked = thread_pool::instance().prewarm(count);
+  TRACE("%u/%u threads prewarmed", parked, count);
+  return parked;
+}
+
 void WASM_EXPORT(start_timers)() {
   TRACE("starting timers");
   auto &tim = timer_queue::instance();
-  while (!tim.start_timer_async(&t1)) {}
-  while (!tim.start_timer_async(&t2)) {}
+  tim.start_timer(&t1);
+  tim.start_timer(&t2);
 }
 
 void WASM_EXPORT(stop_timers)() {
   TRACE("stopping timers");
   auto &tim = timer_queue::instance();
-  while (!tim.stop_timer_async(&t1)) {}
-  while (!tim.stop_timer_async(&t2)) {}
+  tim.stop_timer(&t1);
+  tim.stop_timer(&t2);
 }
 
 void WASM_EXPORT(cleanup)() {
   TRACE("cleanup");
   timer_queue::destroy();
+  thread_pool::instance().drain();
 }
 
+// false until the queue is gone; call again once notified through
+// '_host_queue_stopped'
 bool WASM_EXPORT(async_cleanup)() {
-  return timer_queue::destroy_async();
+  if (!timer_queue::destroy_async()) return false;
+  // parked threads would outlive the instance otherwise
+  thread_pool::instance().drain();
+  return true;
+}
+
+#if defined(TIMER_HOST_DRIVEN)
+extern "C" void __wasm_init_tls(void *);
+
+// Called by the host on the exec env it polls timers from: that env was
+// not started through wasi-threads, so it has no TLS block yet. There is
+// one such env per instance, and polls may come until the instance is
+// gone: one static block, allocated on the first call, serves it.
+void WASM_EXPORT(timer_host_thread_init)() {
+  static void *tls = aligned_alloc(__builtin_wasm_tls_align(),
+                                   __builtin_wasm_tls_size());
+  __wasm_init_tls(tls);
+}
+
+void WASM_EXPORT(timer_host_poll)() {
+  timer_queue::host_poll();
 }
+#endif
 
 __attribute__((constructor))
 void static_init() {
-  _log_func("static_init() called", 21);
+  TRACE("static_init() called");
 }
 
 void std::__libcpp_verbose_abort(char const* format, ...) {
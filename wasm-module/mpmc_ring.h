@@ -0,0 +1,100 @@
+#ifndef MPMC_RING_H
+#define MPMC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free multi-producer / multi-consumer ring.
+//
+// Same cell protocol as 'mpsc_ring', with consumers also claiming slots
+// through a CAS on the tail index.
+template <typename T, size_t Capacity>
+class mpmc_ring {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "capacity must be a power of 2");
+
+  static constexpr size_t mask = Capacity - 1;
+
+  struct cell_t {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  cell_t _cells[Capacity];
+
+  char _pad0[64];
+  std::atomic<size_t> _head;
+  char _pad1[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> _tail;
+
+public:
+  mpmc_ring() : _head(0), _tail(0) {
+    for (size_t i = 0; i < Capacity; i++) {
+      _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpmc_ring(mpmc_ring const &) = delete;
+  void operator=(mpmc_ring const &) = delete;
+
+  static constexpr size_t capacity() { return Capacity; }
+
+  bool push(const T &data) {
+    cell_t *cell;
+    size_t pos = _head.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &_cells[pos & mask];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->data = data;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T &data) {
+    cell_t *cell;
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &_cells[pos & mask];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _tail.load(std::memory_order_relaxed);
+      }
+    }
+
+    data = cell->data;
+    cell->seq.store(pos + Capacity, std::memory_order_release);
+    return true;
+  }
+
+  // a hint only, other consumers may race
+  bool empty() const {
+    size_t pos = _tail.load(std::memory_order_relaxed);
+    const cell_t *cell = &_cells[pos & mask];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    return (intptr_t)seq - (intptr_t)(pos + 1) < 0;
+  }
+};
+
+#endif // MPMC_RING_H
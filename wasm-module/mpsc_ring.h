@@ -0,0 +1,91 @@
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free multi-producer / single-consumer ring.
+//
+// Each cell carries a sequence number telling producers and the consumer
+// whose turn it is (D. Vyukov's bounded queue). Producers only contend on
+// a CAS of the head index; 'push()' fails instead of waiting when full.
+template <typename T, size_t Capacity>
+class mpsc_ring {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "capacity must be a power of 2");
+
+  static constexpr size_t mask = Capacity - 1;
+
+  struct cell_t {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  cell_t _cells[Capacity];
+
+  // keep producer and consumer indexes on separate cache lines (padding
+  // rather than alignas, the ring lives in heap-allocated objects)
+  char _pad0[64];
+  std::atomic<size_t> _head;
+  char _pad1[64 - sizeof(std::atomic<size_t>)];
+  size_t _tail;
+
+public:
+  mpsc_ring() : _head(0), _tail(0) {
+    for (size_t i = 0; i < Capacity; i++) {
+      _cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpsc_ring(mpsc_ring const &) = delete;
+  void operator=(mpsc_ring const &) = delete;
+
+  static constexpr size_t capacity() { return Capacity; }
+
+  // any thread
+  bool push(const T &data) {
+    cell_t *cell;
+    size_t pos = _head.load(std::memory_order_relaxed);
+    while (true) {
+      cell = &_cells[pos & mask];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (_head.compare_exchange_weak(pos, pos + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = _head.load(std::memory_order_relaxed);
+      }
+    }
+
+    cell->data = data;
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer thread only
+  bool pop(T &data) {
+    cell_t *cell = &_cells[_tail & mask];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    if ((intptr_t)seq - (intptr_t)(_tail + 1) < 0) return false;
+
+    data = cell->data;
+    cell->seq.store(_tail + Capacity, std::memory_order_release);
+    _tail++;
+    return true;
+  }
+
+  // consumer thread only
+  bool empty() const {
+    const cell_t *cell = &_cells[_tail & mask];
+    size_t seq = cell->seq.load(std::memory_order_acquire);
+    return (intptr_t)seq - (intptr_t)(_tail + 1) < 0;
+  }
+};
+
+#endif // MPSC_RING_H
@@ -0,0 +1,131 @@
+// stress.cpp - randomized timer populations for 'wamr_runner --stress'
+//
+// Part of bench_module.wasm. Timers are plain heap handles rather than
+// slab timers, so that populations are not capped by TIMER_SLAB_CAPACITY.
+#include "imp_export.h"
+#include "log.h"
+#include "thread_pool.h"
+#include "timer.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+static std::unique_ptr<timer_handle_t[]> _timers;
+static uint32_t _timer_count = 0;
+static std::vector<pooled_thread> _producers;
+static std::atomic<bool> _producing = {false};
+static std::atomic<uint32_t> _cmds_sent = {0};
+
+static void stress_timer_func(timer_handle_t *) {}
+
+// xorshift32: cheap, and the same sequence on every libc
+static uint32_t next_random(uint32_t &state) {
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// Log-uniform in [min, max], so that short and long periods are both
+// well represented.
+static unsigned random_period(uint32_t &state, unsigned min, unsigned max) {
+  unsigned bits_min = 32 - __builtin_clz(min);
+  unsigned bits_max = 32 - __builtin_clz(max);
+  unsigned bits = bits_min + next_random(state) % (bits_max - bits_min + 1);
+  unsigned lo = bits > 1 ? 1u << (bits - 1) : 1;
+  unsigned hi = bits < 32 ? (1u << bits) - 1 : UINT32_MAX;
+  unsigned period = lo + next_random(state) % (hi - lo + 1);
+  return period < min ? min : period > max ? max : period;
+}
+
+// Creates and starts 'count' timers with periods in [min_period,
+// max_period] ms, 'oneshot_pct' percent of them one-shot. Returns how many
+// timers there are in total.
+uint32_t WASM_EXPORT(stress_create_timers)(uint32_t count, uint32_t seed,
+                                           uint32_t min_period,
+                                           uint32_t max_period,
+                                           uint32_t oneshot_pct,
+                                           uint32_t slack) {
+  if (_timers || !count || !min_period || min_period > max_period) {
+    return _timer_count;
+  }
+
+  uint32_t state = seed ? seed : 1;
+  _timers.reset(new timer_handle_t[count]());
+  _timer_count = count;
+
+  std::vector<timer_handle_t *> handles(count);
+  for (uint32_t i = 0; i < count; i++) {
+    bool repeat = next_random(state) % 100 >= oneshot_pct;
+    timer_queue::create_timer(&_timers[i], stress_timer_func, "stress timer",
+                              random_period(state, min_period, max_period),
+                              repeat, slack);
+    handles[i] = &_timers[i];
+  }
+  timer_queue::instance().start_timers(handles.data(), count);
+  TRACE("stress: %u timers", count);
+  return count;
+}
+
+static void producer_loop(uint32_t seed, uint32_t rate, unsigned min_period,
+                          unsigned max_period) {
+  auto &tim = timer_queue::instance();
+  uint32_t state = seed;
+  auto next = std::chrono::steady_clock::now();
+  uint32_t sent = 0;
+
+  while (_producing.load(std::memory_order_relaxed)) {
+    timer_handle_t *t = &_timers[next_random(state) % _timer_count];
+    uint32_t op = next_random(state) % 10;
+    if (op < 4) {
+      tim.start_timer(t);
+    } else if (op < 6) {
+      tim.stop_timer(t);
+    } else {
+      // the period travels with the command: no race with the timer thread
+      unsigned period = random_period(state, min_period, max_period);
+      tim.set_timer_periods(&t, &period, 1);
+    }
+    sent++;
+
+    // paced in bursts of 100 commands
+    if (rate && sent % 100 == 0) {
+      next += std::chrono::microseconds(100000000ull / rate);
+      std::this_thread::sleep_until(next);
+    }
+  }
+  _cmds_sent += sent;
+}
+
+// Starts 'count' threads sending random start / stop / period commands,
+// 'rate' per second each (0: as fast as they can).
+void WASM_EXPORT(stress_start_producers)(uint32_t count, uint32_t rate,
+                                         uint32_t seed, uint32_t min_period,
+                                         uint32_t max_period) {
+  if (!_timers || _producing.exchange(true)) return;
+
+  _cmds_sent = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t producer_seed = (seed ? seed : 1) * 2654435761u + i;
+    _producers.emplace_back([=]() {
+      producer_loop(producer_seed, rate, min_period, max_period);
+    });
+  }
+}
+
+// Returns the number of commands sent.
+uint32_t WASM_EXPORT(stress_stop_producers)() {
+  _producing = false;
+  for (auto &p : _producers) p.join();
+  _producers.clear();
+  return _cmds_sent;
+}
+
+// Once the timer queue is destroyed ('cleanup' / 'async_cleanup').
+void WASM_EXPORT(stress_free_timers)() {
+  _timers.reset();
+  _timer_count = 0;
+}
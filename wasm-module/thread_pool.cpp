@@ -0,0 +1,162 @@
+#include "thread_pool.h"
+#include "host_notify.h"
+#include "log.h"
+#include "mem_usage.h"
+
+static void *_thread_main(void *arg)
+{
+  auto slot = static_cast<thread_slot *>(arg);
+  std::unique_lock<std::mutex> lock(slot->mutex);
+  while (true) {
+    slot->cond.wait(lock, [&]() { return slot->busy || slot->exit; });
+    if (!slot->busy) break;
+
+    std::function<void()> func;
+    func.swap(slot->func);
+    lock.unlock();
+    // a no-op once the thread is profiled, or until profiling starts
+    mem_usage_thread_begin();
+    func();
+    // captures go before the joiner carries on
+    func = nullptr;
+    lock.lock();
+
+    slot->busy = false;
+    slot->cond.notify_all();
+  }
+  lock.unlock();
+  mem_usage_thread_end();
+  _host_thread_exit();
+  return nullptr;
+}
+
+pooled_thread::pooled_thread(std::function<void()> func)
+    : _slot(thread_pool::instance().acquire())
+{
+  if (!_slot) return;
+
+  std::lock_guard<std::mutex> lock(_slot->mutex);
+  _slot->func = std::move(func);
+  _slot->busy = true;
+  _slot->cond.notify_all();
+}
+
+pooled_thread::pooled_thread(pooled_thread &&other) noexcept = default;
+
+pooled_thread &pooled_thread::operator=(pooled_thread &&other) noexcept
+{
+  join();
+  _slot = std::move(other._slot);
+  return *this;
+}
+
+pooled_thread::~pooled_thread()
+{
+  join();
+}
+
+void pooled_thread::join()
+{
+  if (!_slot) return;
+
+  {
+    std::unique_lock<std::mutex> lock(_slot->mutex);
+    _slot->cond.wait(lock, [&]() { return !_slot->busy; });
+  }
+  thread_pool::instance().release(std::move(_slot));
+}
+
+thread_pool &thread_pool::instance()
+{
+  static thread_pool pool;
+  return pool;
+}
+
+std::unique_ptr<thread_slot> thread_pool::spawn()
+{
+  std::unique_ptr<thread_slot> slot(new thread_slot());
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stack_size) pthread_attr_setstacksize(&attr, _stack_size);
+  }
+  int ret = pthread_create(&slot->thread, &attr, _thread_main, slot.get());
+  pthread_attr_destroy(&attr);
+  if (ret != 0) {
+    LOG_ERROR("<thread_pool> spawn failed (%d)", ret);
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _spawned++;
+  return slot;
+}
+
+std::unique_ptr<thread_slot> thread_pool::acquire()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (!_idle.empty()) {
+      auto slot = std::move(_idle.back());
+      _idle.pop_back();
+      return slot;
+    }
+  }
+  return spawn();
+}
+
+void thread_pool::release(std::unique_ptr<thread_slot> slot)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _idle.push_back(std::move(slot));
+}
+
+void thread_pool::set_stack_size(size_t size)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  _stack_size = size;
+}
+
+uint32_t thread_pool::prewarm(uint32_t count)
+{
+  uint32_t parked;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    parked = _idle.size();
+  }
+  for (; parked < count; parked++) {
+    auto slot = spawn();
+    if (!slot) break;
+    release(std::move(slot));
+  }
+  return parked;
+}
+
+void thread_pool::drain()
+{
+  std::vector<std::unique_ptr<thread_slot>> idle;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    idle.swap(_idle);
+  }
+
+  for (auto &slot : idle) {
+    {
+      std::lock_guard<std::mutex> lock(slot->mutex);
+      slot->exit = true;
+    }
+    slot->cond.notify_all();
+    pthread_join(slot->thread, nullptr);
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _spawned -= idle.size();
+}
+
+uint32_t thread_pool::spawned()
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _spawned;
+}
@@ -0,0 +1,74 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// One pooled thread, and the function it runs
+struct thread_slot {
+  pthread_t thread;
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::function<void()> func;
+  // 'func' handed over and not returned yet
+  bool busy = false;
+  bool exit = false;
+};
+
+// A module thread taken from the thread pool, used like std::thread: the
+// function starts right away, and join() waits for it to return. The
+// thread itself then parks in the pool instead of exiting.
+class pooled_thread {
+  std::unique_ptr<thread_slot> _slot;
+
+public:
+  pooled_thread() = default;
+  // Not joinable if no thread could be started
+  explicit pooled_thread(std::function<void()> func);
+  pooled_thread(pooled_thread &&) noexcept;
+  pooled_thread &operator=(pooled_thread &&) noexcept;
+  // Joins, rather than terminating like std::thread
+  ~pooled_thread();
+
+  bool joinable() const { return (bool)_slot; }
+  void join();
+};
+
+// Parked wasi threads. Each wasi thread spawn makes the runtime create a
+// native thread and instantiate the module again for it; pooled threads
+// pay that once and are handed function after function.
+class thread_pool {
+  std::mutex _mutex;
+  std::vector<std::unique_ptr<thread_slot>> _idle;
+  size_t _stack_size = 0;
+  uint32_t _spawned = 0;
+
+  friend class pooled_thread;
+  std::unique_ptr<thread_slot> spawn();
+  std::unique_ptr<thread_slot> acquire();
+  void release(std::unique_ptr<thread_slot> slot);
+
+public:
+  static thread_pool &instance();
+
+  // Stack size of the threads spawned from now on, 0 for the libc default
+  void set_stack_size(size_t size);
+
+  // Spawns threads until 'count' are parked; returns how many are.
+  uint32_t prewarm(uint32_t count);
+
+  // Ends the parked threads; busy ones park again once joined.
+  void drain();
+
+  // Live threads, parked or busy
+  uint32_t spawned();
+};
+
+#endif // THREAD_POOL_H
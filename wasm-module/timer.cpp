@@ -1,8 +1,16 @@
 #include "timer.h"
+#include "bulk.h"
+#include "timer_backend.h"
+#include "timer_slab.h"
+#include "host_notify.h"
 #include "log.h"
 
+#if defined(TIMER_HOST_DRIVEN)
+#include "host_timer.h"
+#endif
+
 #include <algorithm>
-#include <future>
+#include <ctime>
 #include <mutex>
 
 using lock_guard = std::lock_guard<std::mutex>;
@@ -10,28 +18,86 @@ using unique_lock = std::unique_lock<std::mutex>;
 
 using namespace std::chrono_literals;
 
-static timer_queue* _instance = nullptr;
-static std::future<void> _async_stop;
+// read without the lock once created: callbacks may run under it
+static std::atomic<timer_queue*> _instance = {nullptr};
 static std::mutex _instance_mut;
 
-bool _timer_cmp(timer_handle_t *lh, timer_handle_t *rh) {
-  return lh->next_trigger < rh->next_trigger;
+// set on the timer thread
+static thread_local timer_queue* _current_queue = nullptr;
+
+// outlives the queue, so that it can still be read after 'destroy()'
+static timer_stats_t _stats;
+
+static uint32_t _elapsed_us(time_point_t from, time_point_t to) {
+  if (to <= from) return 0;
+  auto us = std::chrono::duration_cast<std::chrono::microseconds>(to - from);
+  return us.count() < UINT32_MAX ? (uint32_t)us.count() : UINT32_MAX;
+}
+
+static uint64_t _thread_cpu_us() {
+  timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Lateness counts from the nominal trigger to the callback start, so that
+// slack and time spent queued for a worker are included.
+static void _run_callback(timer_handle_t *t) {
+  auto start = std::chrono::steady_clock::now();
+  time_point_t scheduled(std::chrono::duration_cast<time_point_t::duration>(
+      std::chrono::nanoseconds(t->scheduled_ns.load())));
+  uint32_t delay_us = _elapsed_us(scheduled, start);
+  timer_hist_record(_stats.fire_delay_us, delay_us);
+  if (t->repeat && delay_us >= t->period * 1000u) {
+    __atomic_fetch_add(&_stats.missed_deadlines, 1, __ATOMIC_RELAXED);
+  }
+
+  t->func(t);
+  timer_hist_record(_stats.callback_us,
+                    _elapsed_us(start, std::chrono::steady_clock::now()));
 }
 
-timer_queue::timer_queue() {
+#if defined(TIMER_BACKEND_VECTOR)
+static constexpr auto _backend_kind = timer_backend_kind::vector;
+#else
+static constexpr auto _backend_kind = timer_backend_kind::wheel;
+#endif
+
+// Rounds 'next_trigger' up to the coarsest power-of-2 millisecond grid that
+// fits in the slack window: timers with overlapping windows then share
+// expiry times, hence wakeups.
+static time_point_t coalesced_expiry(const timer_handle_t *t) {
+  if (!t->slack) return t->next_trigger;
+
+  auto grid = std::chrono::milliseconds(1u << (31 - __builtin_clz(t->slack)));
+  auto since_epoch = t->next_trigger.time_since_epoch();
+  auto rounded = ((since_epoch + grid - 1ns) / grid) * grid;
+  return time_point_t(
+      std::chrono::duration_cast<time_point_t::duration>(rounded));
+}
+
+timer_queue::timer_queue()
+    : _backend(make_timer_backend(_backend_kind)),
+      _deferred(&_stats.deferred_delay_us) {
+#if defined(TIMER_HOST_DRIVEN)
+  // nothing to spawn
   start();
+#endif
 }
 
-void timer_queue::update_current_time() {
-  _current_time = std::chrono::steady_clock::now();
+timer_queue::~timer_queue() {
+  stop_workers();
 }
 
-void timer_queue::sort_timers() {
-  std::sort(_timers.begin(), _timers.end(), _timer_cmp);
+void timer_queue::update_current_time() {
+  _current_time = std::chrono::steady_clock::now();
 }
 
 timer_queue& timer_queue::instance()
 {
+  timer_queue *q = _instance.load(std::memory_order_acquire);
+  if (q) return *q;
+
   lock_guard lock(_instance_mut);
   if (!_instance) {
     _instance = new timer_queue();
@@ -42,11 +108,101 @@ timer_queue& timer_queue::instance()
 void timer_queue::destroy()
 {
   lock_guard lock(_instance_mut);
-  if (_instance) { _instance->stop(); }
-  delete _instance;
+  timer_queue *q = _instance;
+  if (q) { q->stop(); }
   _instance = nullptr;
+  delete q;
 }
 
+#if defined(TIMER_HOST_DRIVEN)
+
+bool timer_queue::destroy_async()
+{
+  std::unique_lock<std::mutex> lock(_instance_mut, std::try_to_lock);
+  if(!lock.owns_lock()) {
+    return false;
+  }
+
+  // no thread to join: stopping never blocks
+  timer_queue *q = _instance;
+  if (q) { q->stop(); }
+  _instance = nullptr;
+  delete q;
+  return true;
+}
+
+void timer_queue::start()
+{
+  _running = true;
+}
+
+void timer_queue::stop() {
+  _running = false;
+  _host_timer_arm(TIMER_HOST_DISARM);
+  stop_workers();
+  _deferred.stop();
+  _stopped = true;
+  _host_queue_stopped();
+}
+
+void timer_queue::host_poll()
+{
+  // destroy() or instance() in progress: try again shortly
+  std::unique_lock<std::mutex> lock(_instance_mut, std::try_to_lock);
+  if (!lock.owns_lock()) {
+    _host_timer_arm(1000);
+    return;
+  }
+
+  timer_queue *q = _instance;
+  if (q) { q->poll(); }
+}
+
+void timer_queue::poll()
+{
+  uint64_t cpu_start = _thread_cpu_us();
+  _poll_requested = false;
+  _current_queue = this;
+
+  update_current_time();
+  process_cmds();
+  release_retired();
+  if (_running) {
+    _stats.wakeups++;
+    flush_dispatch_backlog();
+    trigger_timers();
+  }
+
+  _current_queue = nullptr;
+  arm_host_timer();
+  _stats.timer_cpu_us += (uint32_t)(_thread_cpu_us() - cpu_start);
+}
+
+void timer_queue::arm_host_timer()
+{
+  time_point_t deadline;
+  uint32_t delay_us = TIMER_HOST_DISARM;
+  if (_running && next_wakeup(deadline)) {
+    delay_us = _elapsed_us(std::chrono::steady_clock::now(), deadline);
+  }
+  _host_timer_arm(delay_us);
+
+  // a command posted since the queue was drained may have armed the host
+  // timer before we did
+  if (_poll_requested || !_cmds.empty()) {
+    _host_timer_arm(0);
+  }
+}
+
+void timer_queue::notify_cmds()
+{
+  if (!_poll_requested.exchange(true)) {
+    _host_timer_arm(0);
+  }
+}
+
+#else
+
 bool timer_queue::destroy_async()
 {
   std::unique_lock<std::mutex> lock(_instance_mut, std::try_to_lock);
@@ -54,72 +210,137 @@ bool timer_queue::destroy_async()
     return false;  
   }
 
-  if (_instance) {
-    if (_instance->_running) {
-      if (!_instance->stop_async() || _async_stop.valid()) {
-        return false;
-      }
-      _async_stop =
-          std::async(std::launch::async, []() { _instance->_thread->join(); });
-    } else if (_async_stop.valid() &&
-               _async_stop.wait_for(0s) == std::future_status::ready) {
-      delete _instance;
-      _instance = nullptr;
-      _async_stop = {};
+  timer_queue *q = _instance;
+  if (q && !q->_started) {
+    // never got a command, or its thread failed to spawn: no thread to stop
+    _instance = nullptr;
+    delete q;
+  } else if (q) {
+    if (!q->_stopped) {
+      // the timer thread winds down, then calls '_host_queue_stopped()'
+      if (!q->_stop_sent) q->_stop_sent = q->stop_async();
+      return false;
     }
+    // only returning from its thread function by now
+    q->_thread.join();
+    _instance = nullptr;
+    delete q;
   }
 
-  return _instance == nullptr;
+  return true;
 }
 
 void timer_queue::start()
 {
-  lock_guard lock(_cmds_mutex);
-  if (!_running) {
-    _running = true;
-    _thread = std::make_unique<std::thread>([&]() { main_loop(); });
+  // once: a stopped queue is not restarted by late commands
+  if (_started.exchange(true)) return;
+
+  _running = true;
+  _thread = pooled_thread([&]() {
+    main_loop();
+    // joined by stop(), or by destroy_async() once notified
+    stop_workers();
+    _deferred.stop();
+    _stopped = true;
+    _host_queue_stopped();
+  });
+  if (!_thread.joinable()) {
+    // the next command tries again; until then destroy_async() has no
+    // thread to wait for
+    LOG_ERROR("<timer_queue> no timer thread");
+    _running = false;
+    _started = false;
   }
 }
 
 void timer_queue::stop() {
-  unique_lock lock(_cmds_mutex);
-  if (_running) {
-    _running = false;
-    lock.unlock();
-    _cmds_condition.notify_one();
+  if (_running.exchange(false)) {
+    _cmds_event.notify();
   }
-  _thread->join();
+  _thread.join();
+  stop_workers();
+  _deferred.stop();
+}
+
+void timer_queue::notify_cmds()
+{
+  if (!_started.load(std::memory_order_relaxed)) start();
+  _cmds_event.notify();
+}
+
+#endif // TIMER_HOST_DRIVEN
+
+void timer_queue::start_workers(unsigned count)
+{
+  if (!count || _workers_running.exchange(true)) return;
+
+  for (unsigned i = 0; i < count; i++) {
+    pooled_thread worker([&]() { worker_loop(); });
+    if (!worker.joinable()) break;
+    _workers.emplace_back(std::move(worker));
+  }
+  if (_workers.size() < count) {
+    LOG_ERROR("<timer_queue> %u of %u workers started",
+              (unsigned)_workers.size(), count);
+  }
+  if (_workers.empty()) {
+    // callbacks keep running on the timer thread
+    _workers_running = false;
+    return;
+  }
+  _dispatching = true;
+}
+
+void timer_queue::stop_workers()
+{
+  if (!_workers_running.exchange(false)) return;
+
+  _dispatch_event.notify_all();
+  for (auto &w : _workers) {
+    w.join();
+  }
+  _workers.clear();
+}
+
+const timer_stats_t& timer_queue::stats()
+{
+  return _stats;
 }
 
 void timer_queue::create_timer(timer_handle_t *timer, timer_func_t func, const char *name,
-                            unsigned period, bool repeat) {
+                            unsigned period, bool repeat, unsigned slack) {
   timer->func = func;
   timer->name = name;
   timer->period = period;
   timer->repeat = repeat;
+  timer->slack = slack;
   timer->next_trigger = time_point_t{};
+  timer->expiry = time_point_t{};
 }
 
 void timer_queue::send_cmd(timer_req_t&& req)
 {
-  {
-    lock_guard lock(_cmds_mutex);
-    _cmds.emplace_back(req);
+  if (_current_queue == this) {
+    // from a callback: the queue might be full and nobody would drain it
+    update_current_time();
+    process_cmd(req);
+    return;
   }
-  _cmds_condition.notify_one();
+
+  // only waits on the timer thread draining a full queue, never on a lock
+  while (!_cmds.push(req)) {
+    std::this_thread::yield();
+  }
+  notify_cmds();
 }
 
 bool timer_queue::send_cmd_async(timer_req_t&& req)
 {
-  {
-    std::unique_lock<std::mutex> lock(_cmds_mutex, std::try_to_lock);
-    if(!lock.owns_lock()) {
-      return false;  
-    }
-    _cmds.emplace_back(req);
+  if (!_cmds.push(req)) {
+    return false;
   }
 
-  _cmds_condition.notify_one();
+  notify_cmds();
   return true;
 }
 
@@ -132,10 +353,45 @@ void timer_queue::stop_timer(timer_handle_t *timer) {
 }
 
 void timer_queue::pend_function(timer_async_func_t func, void *param1,
-                                uint32_t param2) {
-  send_cmd(timer_req_t{
-      .cmd = timer_req_t::cmd_pend_func,
-      .func_call = {.func = func, .param1 = param1, .param2 = param2}});
+                                uint32_t param2, deferred_priority prio,
+                                deferred_completion *completion) {
+  _deferred.post(func, param1, param2, prio, completion);
+}
+
+bool timer_queue::pend_function_async(timer_async_func_t func, void *param1,
+                                      uint32_t param2, deferred_priority prio,
+                                      deferred_completion *completion) {
+  return _deferred.try_post(func, param1, param2, prio, completion);
+}
+
+void timer_queue::send_batch(timer_req_t::type cmd,
+                             timer_handle_t *const *timers,
+                             const unsigned *periods, size_t count)
+{
+  if (!count) return;
+
+  auto entries = new timer_batch_entry_t[count];
+  timer_batch_pack(entries, timers, periods, count);
+
+  timer_req_t req{.cmd = cmd};
+  req.batch = {.entries = entries, .count = (uint32_t)count};
+  send_cmd(std::move(req));
+}
+
+void timer_queue::start_timers(timer_handle_t *const *timers, size_t count)
+{
+  send_batch(timer_req_t::cmd_start_batch, timers, nullptr, count);
+}
+
+void timer_queue::stop_timers(timer_handle_t *const *timers, size_t count)
+{
+  send_batch(timer_req_t::cmd_stop_batch, timers, nullptr, count);
+}
+
+void timer_queue::set_timer_periods(timer_handle_t *const *timers,
+                                    const unsigned *periods, size_t count)
+{
+  send_batch(timer_req_t::cmd_set_period_batch, timers, periods, count);
 }
 
 bool timer_queue::start_timer_async(timer_handle_t *timer)
@@ -143,6 +399,10 @@ bool timer_queue::start_timer_async(timer_handle_t *timer)
   return send_cmd_async(timer_req_t{.cmd = timer_req_t::cmd_start, .timer = timer});
 }
 
+void timer_queue::destroy_timer(timer_handle_t *timer) {
+  send_cmd(timer_req_t{.cmd = timer_req_t::cmd_destroy, .timer = timer});
+}
+
 bool timer_queue::stop_timer_async(timer_handle_t *timer)
 {
   return send_cmd_async(timer_req_t{.cmd = timer_req_t::cmd_stop, .timer = timer});
@@ -155,110 +415,259 @@ bool timer_queue::stop_async() {
 
 void timer_queue::main_loop() {
 
+  _current_queue = this;
+  // pooled threads carry the CPU time of their earlier functions
+  uint64_t cpu_start = _thread_cpu_us();
+
   TRACE("<timer_queue> started");
   while (true) {
-    {
-      unique_lock lock(_cmds_mutex);
-      update_current_time();
-      process_cmds();
-
-      if (!_running) break;
-
-      bool has_waited = false;
-      if (_timers.size() > 0) {
-        timer_handle_t* t = _timers[0];
-        if (t->active && t->next_trigger >= _current_time) {
-          has_waited = true;
-          _cmds_condition.wait_for(lock, t->next_trigger - _current_time);
-        }
-      }
+    update_current_time();
+    process_cmds();
+    release_retired();
+    if (!_running) break;
 
-      if (!has_waited) { _cmds_condition.wait_for(lock, 500ms); }
-      if (!_running) break;
+    wait_for_cmds();
+    if (!_running) break;
 
-      update_current_time();
-    }
-
-    async_calls();
+    _stats.wakeups++;
+    update_current_time();
+    flush_dispatch_backlog();
     trigger_timers();
+    _stats.timer_cpu_us = (uint32_t)(_thread_cpu_us() - cpu_start);
   }
+  release_retired();
+  _current_queue = nullptr;
   TRACE("<timer_queue> stopped");
 }
 
+bool timer_queue::next_wakeup(time_point_t &deadline)
+{
+  bool has_deadline = _backend->next_deadline(deadline);
+  if (!_dispatch_backlog.empty()) {
+    // retry soon, workers are catching up
+    deadline = has_deadline ? std::min(deadline, _current_time + 1ms)
+                            : _current_time + 1ms;
+    has_deadline = true;
+  }
+  return has_deadline;
+}
+
+void timer_queue::wait_for_cmds()
+{
+  time_point_t deadline;
+  bool has_deadline = next_wakeup(deadline);
+  if (has_deadline && deadline <= _current_time) return;
+
+  uint32_t key = _cmds_event.prepare_wait();
+  if (!_cmds.empty() || !_running) {
+    _cmds_event.cancel_wait();
+  } else if (has_deadline) {
+    _cmds_event.wait_until(key, deadline);
+  } else {
+    // nothing scheduled: sleep until the next command
+    _cmds_event.wait(key);
+  }
+}
+
 void timer_queue::process_cmds()
 {
-  int added = 0;
-  while (!_cmds.empty()) {
-    timer_req_t req = _cmds.back();
-    _cmds.pop_back();
+  // bounded, so that busy producers cannot starve the timers
+  timer_req_t req;
+  size_t n = 0;
+  for (; n < _cmds.capacity() && _cmds.pop(req); n++) {
+    process_cmd(req);
+    if (!_running) break;
+  }
+  timer_hist_record(_stats.cmds_per_wakeup, n);
+  update_active_timers();
+}
+
+void timer_queue::update_active_timers()
+{
+  _stats.active_timers = _backend->size();
+  if (_stats.active_timers > _stats.active_timers_max) {
+    _stats.active_timers_max = _stats.active_timers;
+  }
+}
 
-    if (req.cmd == timer_req_t::cmd_stop_timer_queue) {
-      _running = false;
-      return;
-    }
+void timer_queue::process_cmd(const timer_req_t &req)
+{
+  switch (req.cmd) {
+  case timer_req_t::cmd_stop_timer_queue:
+    _running = false;
+    break;
 
-    if (req.cmd == timer_req_t::cmd_pend_func) {
-      if (req.func_call.func) {
-        _funcs.emplace_back(std::move(req.func_call));
-      }
-    } else {
-      timer_handle_t *t = req.timer;
-      auto pos = std::find(_timers.begin(), _timers.end(), t);
-      switch (req.cmd) {
-      case timer_req_t::cmd_start:
-        t->next_trigger = _current_time + (t->period * 1ms);
-        t->active = true;
-        if (pos == _timers.end()) {
-          _timers.emplace_back(t);
-          added++;
-        }
-        break;
+  case timer_req_t::cmd_start:
+    start_now(req.timer);
+    break;
 
-      case timer_req_t::cmd_stop:
-        if (pos != _timers.end()) {
-          _timers.erase(pos);
-        }
-        break;
+  case timer_req_t::cmd_stop:
+    stop_now(req.timer);
+    break;
 
-      default:
-        break;
-      }
+  case timer_req_t::cmd_destroy:
+    destroy_now(req.timer);
+    break;
+
+  case timer_req_t::cmd_start_batch:
+  case timer_req_t::cmd_stop_batch:
+  case timer_req_t::cmd_set_period_batch:
+    process_batch(req);
+    break;
+
+  default:
+    break;
+  }
+}
+
+void timer_queue::process_batch(const timer_req_t &req)
+{
+  const timer_batch_t &batch = req.batch;
+  for (uint32_t i = 0; i < batch.count; i++) {
+    timer_handle_t *t = batch.entries[i].timer;
+    if (!t) continue;
+
+    switch (req.cmd) {
+    case timer_req_t::cmd_start_batch:
+      start_now(t);
+      break;
+    case timer_req_t::cmd_stop_batch:
+      stop_now(t);
+      break;
+    case timer_req_t::cmd_set_period_batch:
+      t->period = batch.entries[i].period;
+      start_now(t);
+      break;
+    default:
+      break;
     }
   }
-  if (added) sort_timers();
+  delete[] batch.entries;
+}
+
+void timer_queue::start_now(timer_handle_t *t)
+{
+  t->next_trigger = _current_time + (t->period * 1ms);
+  t->expiry = coalesced_expiry(t);
+  t->active = true;
+  _backend->insert(t);
+}
+
+void timer_queue::stop_now(timer_handle_t *t)
+{
+  t->active = false;
+  _backend->remove(t);
+}
+
+void timer_queue::destroy_now(timer_handle_t *t)
+{
+  stop_now(t);
+
+  // otherwise the worker running its callback releases it
+  unsigned pending = t->dispatch_pending.fetch_or(TIMER_DISPATCH_DESTROYED);
+  if (!(pending & ~TIMER_DISPATCH_DESTROYED)) {
+    _retired.emplace_back(t);
+  }
+}
+
+void timer_queue::release_retired()
+{
+  for (auto t : _retired) {
+    timer_slab::release(t);
+  }
+  _retired.clear();
 }
 
 void timer_queue::trigger_timers() {
-  int triggered = 0;
-  for (auto t : _timers) {
-    if (t->next_trigger <= _current_time) {
-      if (t->repeat) {
-        t->next_trigger += t->period * 1ms;
-      } else {
-        t->active = false;
-        stop_timer(t);
-      }
-      t->func(t);
-      triggered++;
+  bool dispatching = _dispatching;
+  _backend->expire(_current_time, _expired);
+  for (auto t : _expired) {
+    // stopped or destroyed by an earlier callback of this batch, whose
+    // commands run inline
+    if (!t->active || (t->dispatch_pending & TIMER_DISPATCH_DESTROYED)) {
+      continue;
+    }
+
+    // restarted by one: still due now, but already re-armed from now on
+    bool restarted = t->next_trigger > _current_time;
+    t->scheduled_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        (restarted ? _current_time : t->next_trigger).time_since_epoch())
+        .count();
+    if (!restarted && t->repeat) {
+      t->next_trigger += t->period * 1ms;
+      t->expiry = coalesced_expiry(t);
+      _backend->insert(t);
+    } else if (!restarted) {
+      t->active = false;
+    }
+    if (dispatching) {
+      dispatch(t);
     } else {
-      break;
+      _run_callback(t);
     }
   }
-  if (triggered) sort_timers();
+  _expired.clear();
+  update_active_timers();
 }
 
-void timer_queue::async_calls() {
-  for (auto f : _funcs) {
-    f.func(f.param1, f.param2);
+void timer_queue::dispatch(timer_handle_t *timer) {
+  // already queued or running: its worker runs it once more
+  if (timer->dispatch_pending.fetch_add(1) > 0) return;
+
+  if (!_dispatch_backlog.empty() || !_dispatch.push(timer)) {
+    _dispatch_backlog.emplace_back(timer);
+    return;
+  }
+  _dispatch_event.notify();
+}
+
+void timer_queue::flush_dispatch_backlog() {
+  size_t n = 0;
+  while (n < _dispatch_backlog.size() && _dispatch.push(_dispatch_backlog[n])) {
+    n++;
+  }
+  if (n) {
+    _dispatch_backlog.erase(_dispatch_backlog.begin(),
+                            _dispatch_backlog.begin() + n);
+    _dispatch_event.notify_all();
+  }
+}
+
+void timer_queue::worker_loop() {
+  timer_handle_t *t;
+  while (true) {
+    if (_dispatch.pop(t)) {
+      unsigned pending;
+      do {
+        if (!(t->dispatch_pending & TIMER_DISPATCH_DESTROYED)) {
+          _run_callback(t);
+        }
+        pending = t->dispatch_pending.fetch_sub(1);
+      } while ((pending & ~TIMER_DISPATCH_DESTROYED) > 1);
+
+      if (pending & TIMER_DISPATCH_DESTROYED) {
+        timer_slab::release(t);
+      }
+      continue;
+    }
+
+    uint32_t key = _dispatch_event.prepare_wait();
+    if (!_dispatch.empty()) {
+      _dispatch_event.cancel_wait();
+    } else if (!_workers_running) {
+      _dispatch_event.cancel_wait();
+      break;
+    } else {
+      _dispatch_event.wait(key);
+    }
   }
-  _funcs.clear();
 }
 
 int timer_create(timer_handle_t* h, timer_func_t func, const char* name,
-                 unsigned period, bool repeat)
+                 unsigned period, bool repeat, unsigned slack = 0)
 {
   if (!h || !func) return -1;
-  timer_queue::create_timer(h, func, name, period, repeat);
+  timer_queue::create_timer(h, func, name, period, repeat, slack);
   return 0;
 }
 
@@ -293,3 +702,29 @@ int timer_set_period(timer_handle_t *h, unsigned period)
   timer_queue::instance().start_timer(h);
   return 0;
 }
+
+timer_id_t timer_alloc(timer_func_t func, const char *name, unsigned period,
+                       bool repeat, unsigned slack)
+{
+  if (!func) return TIMER_INVALID_ID;
+
+  timer_handle_t *h;
+  timer_id_t id = timer_slab::alloc(h);
+  if (id != TIMER_INVALID_ID) {
+    timer_queue::create_timer(h, func, name, period, repeat, slack);
+  }
+  return id;
+}
+
+timer_handle_t *timer_get(timer_id_t id)
+{
+  return timer_slab::get(id);
+}
+
+int timer_destroy(timer_id_t id)
+{
+  timer_handle_t *h = timer_slab::retire(id);
+  if (!h) return -1;
+  timer_queue::instance().destroy_timer(h);
+  return 0;
+}
@@ -1,18 +1,25 @@
 #ifndef TIMER_H
 #define TIMER_H
 
-#include <condition_variable>
-#include <deque>
+#include <atomic>
+#include <cstdint>
 #include <memory>
-#include <mutex>
 #include <thread>
 #include <vector>
 #include <chrono>
 
+#include "deferred.h"
+#include "mpmc_ring.h"
+#include "mpsc_ring.h"
+#include "thread_pool.h"
+#include "timer_stats.h"
+#include "wakeup.h"
+
 struct timer_handle_t;
+class timer_backend;
 
 typedef void (*timer_func_t)(timer_handle_t*);
-typedef void (*timer_async_func_t)(void*, uint32_t);
+typedef deferred_func_t timer_async_func_t;
 typedef std::chrono::steady_clock::time_point time_point_t;
 
 struct timer_handle_t {
@@ -20,58 +27,136 @@ struct timer_handle_t {
   const char*  name;
   unsigned     period;
   bool         repeat;
+  // how late (ms) the timer may fire, to be coalesced with others
+  unsigned     slack;
 
+  // nominal schedule / when the timer actually fires
   time_point_t next_trigger;
+  time_point_t expiry;
   std::atomic_bool active;
+
+  // callbacks queued to or running on a worker, plus the
+  // TIMER_DISPATCH_DESTROYED flag
+  std::atomic<unsigned> dispatch_pending;
+  // 'next_trigger' (steady_clock ns) of the latest fire, read when its
+  // callback starts
+  std::atomic<int64_t>  scheduled_ns;
+
+  // timing wheel linkage, owned by the timer thread
+  timer_handle_t*  wheel_next;
+  timer_handle_t** wheel_pprev;
+  unsigned         wheel_slot;
+  // expiry tick it was linked at
+  uint64_t         wheel_tick;
 };
 
 #define TIMER_INITIALIZER \
   { .func = nullptr, .name = nullptr }
 
-struct timer_async_call_t {
-  timer_async_func_t func;
-  void *param1;
-  uint32_t param2;
+// set once a slab timer is destroyed, its slot is freed when no callback
+// is left in flight
+#define TIMER_DISPATCH_DESTROYED 0x80000000u
+
+// handle to a timer allocated with 'timer_alloc()'
+typedef uint32_t timer_id_t;
+#define TIMER_INVALID_ID 0
+
+struct timer_batch_entry_t {
+  timer_handle_t *timer;
+  unsigned period;
+};
+
+// owned by the command, released by the timer thread
+struct timer_batch_t {
+  timer_batch_entry_t *entries;
+  uint32_t count;
 };
 
 struct timer_req_t {
   enum type {
     cmd_start,
     cmd_stop,
-    cmd_pend_func,
     cmd_stop_timer_queue,
+    cmd_start_batch,
+    cmd_stop_batch,
+    cmd_set_period_batch,
+    cmd_destroy,
   };
 
   type cmd;
 
   union {
     timer_handle_t *timer;
-    timer_async_call_t func_call;
+    timer_batch_t batch;
   };
 };
 
+#define TIMER_CMD_QUEUE_SIZE 1024
+#define TIMER_DISPATCH_QUEUE_SIZE 1024
+
 class timer_queue {
 
-  std::unique_ptr<std::thread> _thread;
+  pooled_thread _thread;
+  // spawned by the first command, so that creating timers starts no thread
+  std::atomic<bool> _started = {false};
   std::atomic<bool> _running = {false};
+  // the timer thread has stopped everything and is about to exit
+  std::atomic<bool> _stopped = {false};
+  // destroy_async() queued the stop command
+  bool _stop_sent = false;
+
+  mpsc_ring<timer_req_t, TIMER_CMD_QUEUE_SIZE> _cmds;
+  wakeup_event _cmds_event;
+
+  std::unique_ptr<timer_backend> _backend;
+  std::vector<timer_handle_t*> _expired;
+  // destroyed slab timers, released once no expiry batch refers to them
+  std::vector<timer_handle_t*> _retired;
+
+  // optional callback executor
+  std::vector<pooled_thread> _workers;
+  std::atomic<bool> _workers_running = {false};
+  std::atomic<bool> _dispatching = {false};
+  mpmc_ring<timer_handle_t*, TIMER_DISPATCH_QUEUE_SIZE> _dispatch;
+  wakeup_event _dispatch_event;
+  std::vector<timer_handle_t*> _dispatch_backlog;
+
+  // pend_function() calls
+  deferred_executor _deferred;
 
-  std::deque<timer_req_t> _cmds;
-  std::mutex _cmds_mutex;
-  std::condition_variable _cmds_condition;
+  time_point_t _current_time;
 
-  std::vector<timer_handle_t*> _timers;
-  std::vector<timer_async_call_t> _funcs;
+  // TIMER_HOST_DRIVEN: a poll is already requested from the host
+  std::atomic<bool> _poll_requested = {false};
 
-  time_point_t _current_time;
-  
   timer_queue();
+  ~timer_queue();
 
   void update_current_time();
-  void sort_timers();
   void main_loop();
   void trigger_timers();
-  void async_calls();
   void process_cmds();
+  void process_cmd(const timer_req_t &req);
+  void update_active_timers();
+  void process_batch(const timer_req_t &req);
+  void start_now(timer_handle_t *timer);
+  void stop_now(timer_handle_t *timer);
+  void destroy_now(timer_handle_t *timer);
+  void release_retired();
+  void send_batch(timer_req_t::type cmd, timer_handle_t *const *timers,
+                  const unsigned *periods, size_t count);
+  bool next_wakeup(time_point_t &deadline);
+  void wait_for_cmds();
+  void notify_cmds();
+
+  // TIMER_HOST_DRIVEN
+  void poll();
+  void arm_host_timer();
+
+  void dispatch(timer_handle_t *timer);
+  void flush_dispatch_backlog();
+  void worker_loop();
+  void stop_workers();
 
   void send_cmd(timer_req_t&& req);
   bool send_cmd_async(timer_req_t&& req);
@@ -84,22 +169,70 @@ public:
 
   static timer_queue &instance();
   static void destroy();
+  // Never blocks: starts stopping the queue and returns false until it
+  // is destroyed. '_host_queue_stopped()' tells the host when to call
+  // again.
   static bool destroy_async();
 
+  // TIMER_HOST_DRIVEN: no timer thread, the host calls this when the timer
+  // armed through '_host_timer_arm()' expires.
+  static void host_poll();
+
+  // Fire delay / callback duration histograms, wakeup counts, etc.
+  static const timer_stats_t& stats();
+
   static void create_timer(timer_handle_t *timer, timer_func_t func, const char *name,
-                           unsigned period, bool repeat);
+                           unsigned period, bool repeat, unsigned slack = 0);
 
   void start();
 
+  // Hands expired callbacks to 'count' worker threads instead of running
+  // them on the timer thread. Callbacks of the same timer never overlap;
+  // one that is already dispatched may still run after 'stop_timer()'.
+  void start_workers(unsigned count);
+
   void start_timer(timer_handle_t *timer);
   void stop_timer(timer_handle_t *timer);
 
-  void pend_function(timer_async_func_t func, void* param1, uint32_t param2);
-
+  // Runs 'func(param1, param2)' on the deferred executor thread, ahead of
+  // normal priority calls if 'prio' is high. 'completion', if any, is
+  // signalled once the call has returned.
+  void pend_function(timer_async_func_t func, void* param1, uint32_t param2,
+                     deferred_priority prio = deferred_priority::normal,
+                     deferred_completion *completion = nullptr);
+  bool pend_function_async(timer_async_func_t func, void *param1,
+                           uint32_t param2,
+                           deferred_priority prio = deferred_priority::normal,
+                           deferred_completion *completion = nullptr);
+
+  // Stops a slab timer and returns its slot once no callback is in flight.
+  // Use 'timer_destroy()' rather than calling this directly.
+  void destroy_timer(timer_handle_t *timer);
+
+  // Batch variants: one command for the whole array. Null handles are
+  // skipped; 'set_timer_periods()' (re)starts every timer.
+  void start_timers(timer_handle_t *const *timers, size_t count);
+  void stop_timers(timer_handle_t *const *timers, size_t count);
+  void set_timer_periods(timer_handle_t *const *timers, const unsigned *periods,
+                         size_t count);
+
+  // Non-blocking variants: fail only if the command queue is full.
   bool start_timer_async(timer_handle_t *timer);
   bool stop_timer_async(timer_handle_t *timer);
 
   bool stop_async();
 };
 
+// Dynamically allocated timers, backed by a fixed-size slab (see
+// timer_slab.h). Returns TIMER_INVALID_ID when the slab is exhausted.
+timer_id_t timer_alloc(timer_func_t func, const char *name, unsigned period,
+                       bool repeat, unsigned slack = 0);
+
+// Null for unknown or destroyed IDs.
+timer_handle_t *timer_get(timer_id_t id);
+
+// Stops the timer and invalidates 'id'. A callback already running on a
+// worker completes, queued ones are dropped.
+int timer_destroy(timer_id_t id);
+
 #endif // TIMER_H
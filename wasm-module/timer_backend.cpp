@@ -0,0 +1,237 @@
+#include "timer_backend.h"
+
+#include <algorithm>
+
+using namespace std::chrono_literals;
+
+std::unique_ptr<timer_backend> make_timer_backend(timer_backend_kind kind)
+{
+  switch (kind) {
+  case timer_backend_kind::vector:
+    return std::make_unique<timer_vector_backend>();
+  case timer_backend_kind::wheel:
+  default:
+    return std::make_unique<timer_wheel_backend>();
+  }
+}
+
+//
+// Sorted vector
+//
+
+static bool _timer_cmp(timer_handle_t *lh, timer_handle_t *rh) {
+  return lh->expiry < rh->expiry;
+}
+
+void timer_vector_backend::sort_timers() {
+  if (_unsorted) {
+    std::sort(_timers.begin(), _timers.end(), _timer_cmp);
+    _unsorted = false;
+  }
+}
+
+void timer_vector_backend::insert(timer_handle_t *timer) {
+  auto pos = std::find(_timers.begin(), _timers.end(), timer);
+  if (pos == _timers.end()) {
+    _timers.emplace_back(timer);
+  }
+  _unsorted = true;
+}
+
+void timer_vector_backend::remove(timer_handle_t *timer) {
+  auto pos = std::find(_timers.begin(), _timers.end(), timer);
+  if (pos != _timers.end()) {
+    _timers.erase(pos);
+  }
+}
+
+bool timer_vector_backend::next_deadline(time_point_t &deadline) {
+  if (_timers.empty()) return false;
+  sort_timers();
+  deadline = _timers[0]->expiry;
+  return true;
+}
+
+void timer_vector_backend::expire(time_point_t now,
+                                  std::vector<timer_handle_t *> &expired) {
+  sort_timers();
+  auto it = _timers.begin();
+  while (it != _timers.end() && (*it)->expiry <= now) {
+    expired.emplace_back(*it);
+    ++it;
+  }
+  _timers.erase(_timers.begin(), it);
+}
+
+//
+// Hierarchical timing wheel
+//
+
+// Distance from 'from' to the next set bit, wrapping around.
+static unsigned _next_set_bit(uint64_t bits, unsigned from) {
+  uint64_t rot = from ? (bits >> from) | (bits << (64 - from)) : bits;
+  return __builtin_ctzll(rot);
+}
+
+timer_wheel_backend::timer_wheel_backend()
+    : _epoch(std::chrono::steady_clock::now()) {}
+
+uint64_t timer_wheel_backend::tick_floor(time_point_t tp) const {
+  if (tp <= _epoch) return 0;
+  return std::chrono::duration_cast<std::chrono::milliseconds>(tp - _epoch)
+      .count();
+}
+
+uint64_t timer_wheel_backend::tick_ceil(time_point_t tp) const {
+  if (tp <= _epoch) return 0;
+  auto d = tp - _epoch;
+  auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(d);
+  return ms.count() + (ms < d ? 1 : 0);
+}
+
+void timer_wheel_backend::link(timer_handle_t *timer) {
+  uint64_t expires = std::max(tick_ceil(timer->expiry), _tick);
+  uint64_t delta = expires - _tick;
+
+  unsigned level = 0;
+  while (level + 1 < levels && delta >= (1ull << (slot_bits * (level + 1)))) {
+    level++;
+  }
+  if (delta >= max_ticks) {
+    // re-cascaded from the last level until actually due
+    expires = _tick + max_ticks - 1;
+  }
+
+  unsigned idx = (expires >> (slot_bits * level)) & slot_mask;
+  timer_handle_t *&head = _slots[level][idx];
+
+  uint64_t bit = 1ull << idx;
+  timer->wheel_tick = expires;
+  if (!(_occupied[level] & bit)) {
+    _slot_min[level][idx] = expires;
+    _min_stale[level] &= ~bit;
+  } else if (expires < _slot_min[level][idx]) {
+    // still a lower bound if stale
+    _slot_min[level][idx] = expires;
+  }
+
+  timer->wheel_next = head;
+  if (head) head->wheel_pprev = &timer->wheel_next;
+  timer->wheel_pprev = &head;
+  timer->wheel_slot = level * slots + idx + 1;
+  head = timer;
+
+  _occupied[level] |= 1ull << idx;
+}
+
+void timer_wheel_backend::unlink(timer_handle_t *timer) {
+  *timer->wheel_pprev = timer->wheel_next;
+  if (timer->wheel_next) timer->wheel_next->wheel_pprev = timer->wheel_pprev;
+
+  unsigned level = (timer->wheel_slot - 1) / slots;
+  unsigned idx = (timer->wheel_slot - 1) % slots;
+  if (!_slots[level][idx]) {
+    _occupied[level] &= ~(1ull << idx);
+  } else if (timer->wheel_tick == _slot_min[level][idx]) {
+    _min_stale[level] |= 1ull << idx;
+  }
+
+  timer->wheel_next = nullptr;
+  timer->wheel_pprev = nullptr;
+  timer->wheel_slot = 0;
+}
+
+void timer_wheel_backend::cascade(unsigned level) {
+  unsigned idx = (_tick >> (slot_bits * level)) & slot_mask;
+
+  timer_handle_t *t = _slots[level][idx];
+  _slots[level][idx] = nullptr;
+  _occupied[level] &= ~(1ull << idx);
+  _min_stale[level] &= ~(1ull << idx);
+
+  while (t) {
+    timer_handle_t *next = t->wheel_next;
+    link(t);
+    t = next;
+  }
+
+  if (idx == 0 && level + 1 < levels) cascade(level + 1);
+}
+
+void timer_wheel_backend::insert(timer_handle_t *timer) {
+  if (timer->wheel_slot) {
+    unlink(timer);
+  } else {
+    _count++;
+  }
+  link(timer);
+}
+
+void timer_wheel_backend::remove(timer_handle_t *timer) {
+  if (timer->wheel_slot) {
+    unlink(timer);
+    _count--;
+  }
+}
+
+uint64_t timer_wheel_backend::slot_min(unsigned level, unsigned idx) {
+  uint64_t bit = 1ull << idx;
+  if (_min_stale[level] & bit) {
+    uint64_t min = UINT64_MAX;
+    for (auto t = _slots[level][idx]; t; t = t->wheel_next) {
+      min = std::min(min, t->wheel_tick);
+    }
+    _slot_min[level][idx] = min;
+    _min_stale[level] &= ~bit;
+  }
+  return _slot_min[level][idx];
+}
+
+bool timer_wheel_backend::next_deadline(time_point_t &deadline) {
+  if (_count == 0) return false;
+
+  // Level 0 slots give exact expiry ticks. At higher levels, the next
+  // occupied slot holds the level's earliest timers: expire() cascades
+  // them down on its way to the earliest one's tick.
+  uint64_t next = UINT64_MAX;
+  for (unsigned level = 0; level < levels; level++) {
+    if (!_occupied[level]) continue;
+    unsigned shift = slot_bits * level;
+    uint64_t block = (_tick + (1ull << shift) - 1) >> shift;
+    block += _next_set_bit(_occupied[level], block & slot_mask);
+    next = std::min(next, level ? slot_min(level, block & slot_mask)
+                                : block);
+  }
+
+  deadline = _epoch + next * 1ms;
+  return true;
+}
+
+void timer_wheel_backend::expire(time_point_t now,
+                                 std::vector<timer_handle_t *> &expired) {
+  uint64_t target = tick_floor(now);
+
+  while (_tick <= target && _count > 0) {
+    unsigned idx = _tick & slot_mask;
+    if (idx == 0) cascade(1);
+
+    timer_handle_t *t = _slots[0][idx];
+    while (t) {
+      timer_handle_t *next = t->wheel_next;
+      unlink(t);
+      _count--;
+      expired.emplace_back(t);
+      t = next;
+    }
+
+    // skip empty slots up to the next block boundary
+    uint64_t pending =
+        idx == slot_mask ? 0 : _occupied[0] & (~0ull << (idx + 1));
+    uint64_t next = pending ? (_tick & ~slot_mask) + __builtin_ctzll(pending)
+                            : (_tick | slot_mask) + 1;
+    _tick = std::min(next, target + 1);
+  }
+
+  // nothing left to cascade: catch up with 'now' in one step
+  if (_tick <= target) _tick = target + 1;
+}
@@ -0,0 +1,103 @@
+#ifndef TIMER_BACKEND_H
+#define TIMER_BACKEND_H
+
+#include "timer.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Storage for active timers, owned and driven by the timer thread.
+//
+// Timers are keyed on 'expiry'. A timer inserted twice is
+// rescheduled, not duplicated.
+class timer_backend {
+public:
+  virtual ~timer_backend() = default;
+
+  virtual void insert(timer_handle_t *timer) = 0;
+  virtual void remove(timer_handle_t *timer) = 0;
+
+  // Earliest point in time at which 'expire()' may return timers.
+  // Returns false if no timer is scheduled.
+  virtual bool next_deadline(time_point_t &deadline) = 0;
+
+  // Removes every timer due at 'now' and appends it to 'expired'.
+  virtual void expire(time_point_t now,
+                      std::vector<timer_handle_t *> &expired) = 0;
+
+  virtual size_t size() const = 0;
+};
+
+enum class timer_backend_kind {
+  vector,
+  wheel,
+};
+
+std::unique_ptr<timer_backend> make_timer_backend(timer_backend_kind kind);
+
+// Sorted vector: O(n) start / stop, O(n log n) after each expiry batch.
+class timer_vector_backend : public timer_backend {
+  std::vector<timer_handle_t*> _timers;
+  bool _unsorted = false;
+
+  void sort_timers();
+
+public:
+  void insert(timer_handle_t *timer) override;
+  void remove(timer_handle_t *timer) override;
+  bool next_deadline(time_point_t &deadline) override;
+  void expire(time_point_t now,
+              std::vector<timer_handle_t *> &expired) override;
+  size_t size() const override { return _timers.size(); }
+};
+
+// Hierarchical timing wheel with 1ms ticks: O(1) start, stop and expire.
+//
+// 4 levels of 64 slots cover 2^24 ticks (~4.6 hours); timers further
+// out are parked in the last level and re-cascaded until due.
+class timer_wheel_backend : public timer_backend {
+public:
+  static constexpr unsigned slot_bits = 6;
+  static constexpr unsigned slots = 1 << slot_bits;
+  static constexpr unsigned levels = 4;
+  static constexpr uint64_t slot_mask = slots - 1;
+  static constexpr uint64_t max_ticks = 1ull << (slot_bits * levels);
+
+private:
+  time_point_t _epoch;
+
+  // next tick to be processed
+  uint64_t _tick = 0;
+  size_t _count = 0;
+
+  timer_handle_t* _slots[levels][slots] = {};
+  uint64_t _occupied[levels] = {};
+
+  // earliest expiry tick in each slot of levels >= 1, unless flagged in
+  // '_min_stale' (its timer was removed): deadlines are then real
+  // expiries rather than cascades
+  uint64_t _slot_min[levels][slots] = {};
+  uint64_t _min_stale[levels] = {};
+
+  uint64_t slot_min(unsigned level, unsigned idx);
+
+  uint64_t tick_ceil(time_point_t tp) const;
+  uint64_t tick_floor(time_point_t tp) const;
+
+  void link(timer_handle_t *timer);
+  void unlink(timer_handle_t *timer);
+  void cascade(unsigned level);
+
+public:
+  timer_wheel_backend();
+
+  void insert(timer_handle_t *timer) override;
+  void remove(timer_handle_t *timer) override;
+  bool next_deadline(time_point_t &deadline) override;
+  void expire(time_point_t now,
+              std::vector<timer_handle_t *> &expired) override;
+  size_t size() const override { return _count; }
+};
+
+#endif // TIMER_BACKEND_H
@@ -0,0 +1,117 @@
+#include "timer_slab.h"
+
+// Zero-initialised state is valid: slots are handed out from '_next_unused'
+// until the first release, so no constructor has to run before use.
+static timer_slab::slot_t _slots[TIMER_SLAB_CAPACITY];
+static std::atomic<uint32_t> _next_unused = {0};
+static std::atomic<uint32_t> _in_use = {0};
+
+// (ABA tag << 32) | (index + 1), 0 when empty
+static std::atomic<uint64_t> _free_head = {0};
+
+// Odd generations mark allocated slots; IDs carry the low 16 bits.
+static timer_id_t _make_id(uint32_t generation, uint32_t index) {
+  return ((generation & 0xFFFF) << 16) | index;
+}
+
+static timer_slab::slot_t *_slot_of(timer_id_t id) {
+  uint32_t index = id & 0xFFFF;
+  uint32_t generation = id >> 16;
+  if (index >= TIMER_SLAB_CAPACITY || !(generation & 1)) return nullptr;
+  return &_slots[index];
+}
+
+static bool _pop_free(uint32_t &index) {
+  uint64_t head = _free_head.load(std::memory_order_acquire);
+  while (true) {
+    uint32_t top = head & 0xFFFFFFFF;
+    if (!top) return false;
+
+    uint32_t next = _slots[top - 1].next_free.load(std::memory_order_relaxed);
+    uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+    if (_free_head.compare_exchange_weak(head, new_head,
+                                         std::memory_order_acquire)) {
+      index = top - 1;
+      return true;
+    }
+  }
+}
+
+static void _push_free(uint32_t index) {
+  uint64_t head = _free_head.load(std::memory_order_relaxed);
+  uint64_t new_head;
+  do {
+    _slots[index].next_free.store(head & 0xFFFFFFFF, std::memory_order_relaxed);
+    new_head = (((head >> 32) + 1) << 32) | (index + 1);
+  } while (!_free_head.compare_exchange_weak(head, new_head,
+                                             std::memory_order_release));
+}
+
+static bool _take_unused(uint32_t &index) {
+  uint32_t next = _next_unused.load(std::memory_order_relaxed);
+  do {
+    if (next >= TIMER_SLAB_CAPACITY) return false;
+  } while (!_next_unused.compare_exchange_weak(next, next + 1));
+  index = next;
+  return true;
+}
+
+timer_id_t timer_slab::alloc(timer_handle_t *&handle) {
+  uint32_t index;
+  if (!_pop_free(index) && !_take_unused(index)) {
+    return TIMER_INVALID_ID;
+  }
+
+  slot_t &slot = _slots[index];
+  timer_handle_t *h = &slot.handle;
+  h->func = nullptr;
+  h->name = nullptr;
+  h->active = false;
+  h->dispatch_pending = 0;
+  h->scheduled_ns = 0;
+  h->wheel_next = nullptr;
+  h->wheel_pprev = nullptr;
+  h->wheel_slot = 0;
+
+  uint32_t generation = slot.generation.fetch_add(1) + 1;
+  _in_use++;
+
+  handle = h;
+  return _make_id(generation, index);
+}
+
+timer_handle_t *timer_slab::get(timer_id_t id) {
+  slot_t *slot = _slot_of(id);
+  if (!slot) return nullptr;
+
+  uint32_t generation = slot->generation.load(std::memory_order_acquire);
+  if (_make_id(generation, id & 0xFFFF) != id) return nullptr;
+  return &slot->handle;
+}
+
+timer_handle_t *timer_slab::retire(timer_id_t id) {
+  slot_t *slot = _slot_of(id);
+  if (!slot) return nullptr;
+
+  uint32_t generation = slot->generation.load();
+  do {
+    if (_make_id(generation, id & 0xFFFF) != id) return nullptr;
+  } while (!slot->generation.compare_exchange_weak(generation, generation + 1));
+
+  return &slot->handle;
+}
+
+void timer_slab::release(timer_handle_t *handle) {
+  uint32_t index = ((char *)handle - (char *)&_slots[0].handle) / sizeof(slot_t);
+  _push_free(index);
+  _in_use--;
+}
+
+bool timer_slab::owns(const timer_handle_t *handle) {
+  return handle >= &_slots[0].handle &&
+         handle <= &_slots[TIMER_SLAB_CAPACITY - 1].handle;
+}
+
+size_t timer_slab::in_use() {
+  return _in_use.load(std::memory_order_relaxed);
+}
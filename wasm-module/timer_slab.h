@@ -0,0 +1,46 @@
+#ifndef TIMER_SLAB_H
+#define TIMER_SLAB_H
+
+#include "timer.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#ifndef TIMER_SLAB_CAPACITY
+#define TIMER_SLAB_CAPACITY 4096
+#endif
+
+static_assert(TIMER_SLAB_CAPACITY > 0 && TIMER_SLAB_CAPACITY <= 0x10000,
+              "timer IDs hold a 16-bit slot index");
+
+// Fixed-capacity pool of cache-line aligned timer slots in static memory.
+//
+// IDs are '(generation << 16) | index': a slot's generation is bumped when
+// its timer is destroyed, so stale IDs never resolve. The free list is a
+// lock-free stack with an ABA tag.
+class timer_slab {
+public:
+  struct alignas(64) slot_t {
+    timer_handle_t handle;
+    std::atomic<uint32_t> generation;
+    std::atomic<uint32_t> next_free;  // index + 1, 0 terminates
+  };
+
+  // Returns TIMER_INVALID_ID when the slab is full.
+  static timer_id_t alloc(timer_handle_t *&handle);
+
+  static timer_handle_t *get(timer_id_t id);
+
+  // Invalidates 'id'. The slot itself is returned by 'release()' once
+  // the timer thread is done with it.
+  static timer_handle_t *retire(timer_id_t id);
+  static void release(timer_handle_t *handle);
+
+  static bool owns(const timer_handle_t *handle);
+
+  static constexpr size_t capacity() { return TIMER_SLAB_CAPACITY; }
+  static size_t in_use();
+};
+
+#endif // TIMER_SLAB_H
@@ -0,0 +1,69 @@
+// timer_stats.h - timer_queue latency / load statistics
+//
+// Shared with the host: the layout only uses 32-bit fields so that it is
+// identical in wasm32 and native builds.
+#ifndef TIMER_STATS_H
+#define TIMER_STATS_H
+
+#include <cstdint>
+
+// Bucket 0 counts zeros, bucket b >= 1 counts [2^(b-1), 2^b - 1]
+#define TIMER_HIST_BUCKETS 32
+
+struct timer_histogram_t {
+  uint32_t buckets[TIMER_HIST_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+};
+
+struct timer_stats_t {
+  timer_histogram_t fire_delay_us;    // callback start vs nominal trigger
+  timer_histogram_t callback_us;      // callback duration
+  timer_histogram_t cmds_per_wakeup;  // command queue depth
+  timer_histogram_t deferred_delay_us; // pend_function() call latency
+  uint32_t wakeups;
+  uint32_t active_timers;
+  uint32_t active_timers_max;
+  // fired at least one period late: a repeating timer skipped a beat
+  uint32_t missed_deadlines;
+  // CPU time of the timer thread, or of host polls with TIMER_DRIVER=host;
+  // wraps after 71 minutes
+  uint32_t timer_cpu_us;
+};
+
+inline unsigned timer_hist_bucket(uint32_t value) {
+  unsigned b = value ? 32 - __builtin_clz(value) : 0;
+  return b < TIMER_HIST_BUCKETS ? b : TIMER_HIST_BUCKETS - 1;
+}
+
+// Safe from several threads, at the cost of 3 relaxed atomics.
+inline void timer_hist_record(timer_histogram_t &h, uint32_t value) {
+  __atomic_fetch_add(&h.buckets[timer_hist_bucket(value)], 1,
+                     __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h.count, 1, __ATOMIC_RELAXED);
+
+  uint32_t max = __atomic_load_n(&h.max, __ATOMIC_RELAXED);
+  while (value > max &&
+         !__atomic_compare_exchange_n(&h.max, &max, value, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+// Upper bound of the bucket holding the 'p'-th percentile (0-100),
+// capped at the recorded maximum.
+inline uint32_t timer_hist_percentile(const timer_histogram_t &h, unsigned p) {
+  if (!h.count) return 0;
+
+  uint64_t rank = ((uint64_t)h.count * p + 99) / 100;
+  uint64_t seen = 0;
+  for (unsigned b = 0; b < TIMER_HIST_BUCKETS; b++) {
+    seen += h.buckets[b];
+    if (seen >= rank && seen > 0) {
+      uint32_t upper = b ? (uint32_t)((1ull << b) - 1) : 0;
+      return upper < h.max ? upper : h.max;
+    }
+  }
+  return h.max;
+}
+
+#endif // TIMER_STATS_H
@@ -0,0 +1,99 @@
+#ifndef WAKEUP_H
+#define WAKEUP_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if !__wasm__
+#include <condition_variable>
+#include <mutex>
+#endif
+
+// Futex-style wakeup for one or more waiting threads.
+//
+// A waiter announces itself with 'prepare_wait()', re-checks its queue
+// and then either sleeps with 'wait()' / 'wait_until()' or calls
+// 'cancel_wait()'. 'notify()' only bumps the sequence number and wakes a
+// waiter when one is (about to be) asleep: producers never touch a lock,
+// and usually not even a shared cache line.
+//
+// On wasm32 this maps onto memory.atomic.wait32 / memory.atomic.notify.
+class wakeup_event {
+  std::atomic<uint32_t> _seq = {0};
+  std::atomic<uint32_t> _sleepers = {0};
+
+#if !__wasm__
+  std::mutex _mutex;
+  std::condition_variable _cond;
+#endif
+
+  void futex_wait(uint32_t key, int64_t timeout_ns) {
+#if __wasm__
+    __builtin_wasm_memory_atomic_wait32((int *)&_seq, (int)key, timeout_ns);
+#else
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto pred = [&]() { return _seq.load() != key; };
+    if (timeout_ns < 0) {
+      _cond.wait(lock, pred);
+    } else {
+      _cond.wait_for(lock, std::chrono::nanoseconds(timeout_ns), pred);
+    }
+#endif
+  }
+
+  void futex_wake(unsigned count) {
+#if __wasm__
+    __builtin_wasm_memory_atomic_notify((int *)&_seq, count);
+#else
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (count == 1) {
+      _cond.notify_one();
+    } else {
+      _cond.notify_all();
+    }
+#endif
+  }
+
+public:
+  uint32_t prepare_wait() {
+    _sleepers.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return _seq.load();
+  }
+
+  void cancel_wait() { _sleepers.fetch_sub(1); }
+
+  void wait(uint32_t key) {
+    futex_wait(key, -1);
+    _sleepers.fetch_sub(1);
+  }
+
+  template <typename Clock, typename Duration>
+  void wait_until(uint32_t key,
+                  const std::chrono::time_point<Clock, Duration> &deadline) {
+    auto timeout = deadline - Clock::now();
+    if (timeout > timeout.zero()) {
+      futex_wait(key,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(timeout)
+                     .count());
+    }
+    _sleepers.fetch_sub(1);
+  }
+
+  // to be called after publishing the work item
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_sleepers.load(std::memory_order_relaxed)) {
+      _seq.fetch_add(1);
+      futex_wake(1);
+    }
+  }
+
+  void notify_all() {
+    _seq.fetch_add(1);
+    futex_wake(UINT32_MAX);
+  }
+};
+
+#endif // WAKEUP_H
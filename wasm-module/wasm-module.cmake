@@ -1,8 +1,14 @@
 # WASM module
 set(WASM_MODULE_BUILD_TYPE "Debug" CACHE STRING "Build type for WASM module (Debug/Release)")
+set(WASM_TIMER_BACKEND "wheel" CACHE STRING "Timer queue backend for WASM module (wheel/vector)")
+set(WASM_TIMER_DRIVER "thread" CACHE STRING "Timer queue driver for WASM module (thread/host)")
+set(WASM_LOG_FORMAT "binary" CACHE STRING "Log record format for WASM module (binary/text)")
+set(WASM_TIMER_SLAB_CAPACITY "4096" CACHE STRING "Dynamic timer slab capacity for WASM module")
+set(WASM_AOT_CPU "" CACHE STRING "wamrc --cpu for module.aot, e.g. 'native' (default: generic target CPU)")
 
 set(wasm_build_dir "${CMAKE_BINARY_DIR}/wasm")
 set(wasm_binary "${wasm_build_dir}/module.wasm")
+set(wasm_bench_binary "${wasm_build_dir}/bench_module.wasm")
 
 # Find or download WASI SDK
 include(FetchWasiSDK)
@@ -14,6 +20,14 @@ include(ExternalProject)
 # Prepare CMAKE_ARGS for external project
 set(wasm_cmake_args
     -DCMAKE_BUILD_TYPE=${WASM_MODULE_BUILD_TYPE}
+    -DTIMER_BACKEND=${WASM_TIMER_BACKEND}
+    -DTIMER_SLAB_CAPACITY=${WASM_TIMER_SLAB_CAPACITY}
+    -DTIMER_DRIVER=${WASM_TIMER_DRIVER}
+    -DLOG_FORMAT=${WASM_LOG_FORMAT}
+    # follows WAMR_SIMD
+    -DSIMD=${WASM_SIMD}
+    # follows WAMR_PERF_PROFILING
+    -DKEEP_NAMES=${WASM_KEEP_NAMES}
     -DCMAKE_TOOLCHAIN_FILE=${WASI_SDK_PATH}/share/cmake/wasi-sdk-pthread.cmake
 )
 
@@ -23,7 +37,7 @@ ExternalProject_Add(wasm_module_build
     CMAKE_ARGS ${wasm_cmake_args}
     BUILD_ALWAYS ON
     INSTALL_COMMAND ""
-    BUILD_BYPRODUCTS ${wasm_binary}
+    BUILD_BYPRODUCTS ${wasm_binary} ${wasm_bench_binary}
 )
 
 # Create imported target for the WASM module
@@ -36,8 +50,9 @@ add_custom_target(wasm_module ALL
 add_custom_command(TARGET wasm_module POST_BUILD
     COMMAND ${CMAKE_COMMAND} -E copy_if_different
         ${wasm_binary}
+        ${wasm_bench_binary}
         ${CMAKE_BINARY_DIR}
-    COMMENT "Copying module.wasm to build directory"
+    COMMENT "Copying module.wasm and bench_module.wasm to build directory"
 )
 
 add_custom_command(TARGET wasm_module POST_BUILD
@@ -48,3 +63,46 @@ add_custom_command(TARGET wasm_module POST_BUILD
         ${CMAKE_SOURCE_DIR}/web/public/
     COMMENT "Copying module.wasm to web/public directory"
 )
+
+# AOT compiled module, preferred by the runner over the interpreter
+find_program(WAMRC_EXECUTABLE wamrc
+    HINTS ${CMAKE_SOURCE_DIR}/wasm-micro-runtime/wamr-compiler/build
+)
+
+if(WAMRC_EXECUTABLE)
+    set(wasm_aot "${CMAKE_BINARY_DIR}/module.aot")
+    set(wasm_bench_aot "${CMAKE_BINARY_DIR}/bench_module.aot")
+    # shared memory and atomics of wasi-threads
+    set(wamrc_args --enable-multi-thread)
+    if(WASM_AOT_CPU)
+        list(APPEND wamrc_args --cpu=${WASM_AOT_CPU})
+    endif()
+    if(WAMR_PERF_PROFILING)
+        # per-function timing, and frame pointers for perf
+        list(APPEND wamrc_args --enable-perf-profiling --enable-linux-perf)
+    endif()
+
+    # The runner only picks up a .aot whose .key sidecar names the .wasm
+    # and the CPU it was compiled for
+    add_custom_command(OUTPUT ${wasm_aot} ${wasm_aot}.key
+        COMMAND ${CMAKE_COMMAND} -E remove -f ${wasm_aot}.key
+        COMMAND ${WAMRC_EXECUTABLE} ${wamrc_args} -o ${wasm_aot} ${wasm_binary}
+        COMMAND aot_key ${wasm_binary} ${wasm_aot} ${WASM_AOT_CPU}
+        DEPENDS ${wasm_binary} aot_key
+        COMMENT "Compiling module.wasm to module.aot"
+    )
+    add_custom_command(OUTPUT ${wasm_bench_aot} ${wasm_bench_aot}.key
+        COMMAND ${CMAKE_COMMAND} -E remove -f ${wasm_bench_aot}.key
+        COMMAND ${WAMRC_EXECUTABLE} ${wamrc_args} -o ${wasm_bench_aot}
+            ${wasm_bench_binary}
+        COMMAND aot_key ${wasm_bench_binary} ${wasm_bench_aot} ${WASM_AOT_CPU}
+        DEPENDS ${wasm_bench_binary} aot_key
+        COMMENT "Compiling bench_module.wasm to bench_module.aot"
+    )
+    add_custom_target(wasm_module_aot ALL
+        DEPENDS ${wasm_aot} ${wasm_bench_aot})
+    add_dependencies(wasm_module_aot wasm_module)
+    message(STATUS "WASM module AOT compiler: ${WAMRC_EXECUTABLE}")
+else()
+    message(STATUS "wamrc not found, module.aot will not be built")
+endif()
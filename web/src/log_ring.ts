@@ -0,0 +1,214 @@
+// Reads the module's log ring (wasm-module/log_ring.h) from shared linear
+// memory, as wamr_runner's log drain does: text records are printed as
+// they are, binary ones are formatted here.
+
+const LOG_RING_RECORDS = 128;
+const LOG_RECORD_TEXT = 232;
+
+// log_ring_t: records, head, tail, dropped, level, then the records
+const RING_TAIL = 8;
+const RING_DROPPED = 12;
+const RING_RECORDS = 20;
+
+// log_record_t: seq, len, time_us_lo, time_us_hi, level, fmt, text
+const RECORD_SIZE = 24 + LOG_RECORD_TEXT;
+const RECORD_TEXT = 24;
+
+const LEVEL_PREFIXES = ['error: ', 'warning: ', '', ''];
+
+interface LogArg {
+  tag: string;
+  value: number | bigint | string;
+}
+
+export class LogRingDrain {
+  private dropped = 0;
+  private epochUs: bigint | null = null;
+
+  constructor(private memory: WebAssembly.Memory, private ring: number) {}
+
+  // Formatted lines of the records written since the last call
+  drain(): string[] {
+    // views are remade on each call: the buffer changes when memory grows
+    const words = new Int32Array(this.memory.buffer);
+    const bytes = new Uint8Array(this.memory.buffer);
+    const lines: string[] = [];
+
+    const tailIndex = (this.ring + RING_TAIL) >> 2;
+    while (true) {
+      const pos = Atomics.load(words, tailIndex) >>> 0;
+      const index = pos & (LOG_RING_RECORDS - 1);
+      const rec = this.ring + RING_RECORDS + index * RECORD_SIZE;
+      const seq = (Atomics.load(words, rec >> 2) + index) >>> 0;
+      if (((seq - (pos + 1)) | 0) < 0) break;
+
+      // copied out before the slot is handed back to the producers
+      const copy = bytes.slice(rec, rec + RECORD_SIZE);
+      Atomics.store(words, rec >> 2, (pos + LOG_RING_RECORDS - index) | 0);
+      Atomics.store(words, tailIndex, (pos + 1) | 0);
+
+      lines.push(this.formatRecord(new DataView(copy.buffer), bytes));
+    }
+
+    const dropped = Atomics.load(words, (this.ring + RING_DROPPED) >> 2) >>> 0;
+    if (dropped !== this.dropped) {
+      lines.push(`${(dropped - this.dropped) >>> 0} log records dropped`);
+      this.dropped = dropped;
+    }
+    return lines;
+  }
+
+  private formatRecord(rec: DataView, mem: Uint8Array): string {
+    const len = Math.min(rec.getUint32(4, true), LOG_RECORD_TEXT);
+    const timeUs = (BigInt(rec.getUint32(12, true)) << 32n) |
+                   BigInt(rec.getUint32(8, true));
+    const level = rec.getUint32(16, true);
+    const fmt = rec.getUint32(20, true);
+
+    if (this.epochUs === null) this.epochUs = timeUs;
+    const ms = Number((timeUs - this.epochUs) / 1000n);
+    const prefix = `[${String(ms).padStart(6)}ms] ${LEVEL_PREFIXES[level] ?? ''}`;
+
+    const text = new Uint8Array(rec.buffer, RECORD_TEXT, len);
+    if (!fmt) return prefix + new TextDecoder().decode(text);
+    if (fmt >= mem.length) return prefix + '<invalid format string>';
+    return prefix + formatArgs(readCString(mem, fmt), readArgs(text));
+  }
+}
+
+export function readCString(mem: Uint8Array, ptr: number): string {
+  let end = ptr;
+  while (end < mem.length && mem[end] !== 0) end++;
+  return new TextDecoder('utf-8').decode(mem.slice(ptr, end));
+}
+
+function readArgs(text: Uint8Array): LogArg[] {
+  const view = new DataView(text.buffer, text.byteOffset, text.length);
+  const args: LogArg[] = [];
+  let off = 0;
+  while (off < text.length) {
+    const tag = String.fromCharCode(text[off++]);
+    if ((tag === 'i' || tag === 'p') && off + 4 <= text.length) {
+      args.push({ tag, value: view.getUint32(off, true) });
+      off += 4;
+    } else if (tag === 'I' && off + 8 <= text.length) {
+      args.push({ tag, value: view.getBigUint64(off, true) });
+      off += 8;
+    } else if (tag === 'd' && off + 8 <= text.length) {
+      args.push({ tag, value: view.getFloat64(off, true) });
+      off += 8;
+    } else if (tag === 's' && off + 2 <= text.length) {
+      const n = Math.min(view.getUint16(off, true), text.length - off - 2);
+      off += 2;
+      const str = new TextDecoder().decode(text.subarray(off, off + n));
+      args.push({ tag, value: str });
+      off += n;
+    } else {
+      break;
+    }
+  }
+  return args;
+}
+
+function asBigInt(arg: LogArg, signed: boolean): bigint {
+  if (typeof arg.value === 'bigint') {
+    return signed ? BigInt.asIntN(64, arg.value) : arg.value;
+  }
+  if (typeof arg.value === 'number' && arg.tag !== 'd') {
+    return signed ? BigInt(arg.value | 0) : BigInt(arg.value >>> 0);
+  }
+  return BigInt(Math.trunc(Number(arg.value) || 0));
+}
+
+// printf subset of log_drain::format(): flags '-' and '0', width and
+// precision are honoured, length modifiers are ignored.
+function formatArgs(fmt: string, args: LogArg[]): string {
+  let out = '';
+  let next = 0;
+  const re = /%([-+ #0]*)(\*|\d+)?(?:\.(\*|\d+))?[hlLqjzt]*([\s\S])?/g;
+  let last = 0;
+  let m: RegExpExecArray | null;
+  while ((m = re.exec(fmt)) !== null) {
+    out += fmt.slice(last, m.index);
+    last = re.lastIndex;
+
+    const [, flags, widthSpec, precSpec, conv] = m;
+    if (conv === '%') {
+      out += '%';
+      continue;
+    }
+    if (!conv) break;
+
+    const take = (spec?: string) => {
+      if (spec !== '*') return spec === undefined ? undefined : Number(spec);
+      const arg = args[next++];
+      return arg ? Number(asBigInt(arg, true)) : 0;
+    };
+    const width = take(widthSpec) ?? 0;
+    const prec = take(precSpec);
+
+    const arg = args[next++];
+    if (!arg) {
+      out += '<?>';
+      continue;
+    }
+
+    let s: string;
+    switch (conv) {
+    case 'd':
+    case 'i':
+      s = asBigInt(arg, true).toString();
+      break;
+    case 'u':
+      s = asBigInt(arg, false).toString();
+      break;
+    case 'x':
+    case 'X':
+    case 'o':
+      s = asBigInt(arg, false).toString(conv === 'o' ? 8 : 16);
+      if (conv === 'X') s = s.toUpperCase();
+      break;
+    case 'c':
+      s = String.fromCharCode(Number(asBigInt(arg, false)));
+      break;
+    case 'f':
+    case 'F':
+      s = Number(arg.value).toFixed(prec ?? 6);
+      break;
+    case 'e':
+    case 'E':
+      // at least two exponent digits, like printf
+      s = Number(arg.value).toExponential(prec ?? 6)
+                            .replace(/e([+-])(\d)$/, (_, sign, d) => `e${sign}0${d}`);
+      if (conv === 'E') s = s.toUpperCase();
+      break;
+    case 'g':
+    case 'G':
+      s = String(Number(Number(arg.value).toPrecision(prec || 6)));
+      break;
+    case 's':
+      s = arg.tag === 's' ? String(arg.value) : '<?>';
+      if (prec !== undefined) s = s.slice(0, prec);
+      break;
+    case 'p':
+      s = '0x' + asBigInt(arg, false).toString(16);
+      break;
+    default:
+      s = `<%${conv}?>`;
+      break;
+    }
+
+    if (s.length < width) {
+      if (flags.includes('-')) {
+        s = s.padEnd(width);
+      } else if (flags.includes('0') && 'diuxXof'.includes(conv)) {
+        const sign = s[0] === '-' ? '-' : '';
+        s = sign + s.slice(sign.length).padStart(width - sign.length, '0');
+      } else {
+        s = s.padStart(width);
+      }
+    }
+    out += s;
+  }
+  return out + fmt.slice(last);
+}
@@ -1,5 +1,9 @@
 import { WASIInstance, WASIThreads } from '@emnapi/wasi-threads';
 import { WASI } from '@tybys/wasm-util';
+import { LogRingDrain } from './log_ring';
+
+// how often the module's log ring is drained
+const LOG_DRAIN_MS = 50;
 
 interface WasmExports {
   [key: string]: any;
@@ -8,6 +12,7 @@ interface WasmExports {
 class WasmRunner {
   private wasiThreads: WASIThreads;
   private instance: WebAssembly.Instance | null = null;
+  private log: LogRingDrain | null = null;
 
   constructor() {
     const wasi = new WASI({ version: 'preview1' });
@@ -59,6 +64,10 @@ class WasmRunner {
             const log_line = this.readCString(buf);
             this.appendOutput(log_line);
           },
+          // host timer mode and profiling are native-host only
+          _host_timer_arm: (_delay_us: number) => {},
+          _host_queue_stopped: () => {},
+          _host_thread_exit: () => {},
         },
       });
       this.instance = instance;
@@ -68,6 +77,7 @@ class WasmRunner {
       // Initialize WASI
       this.wasiThreads.initialize(instance, module, memory);
       await this.wasiThreads.preloadWorkers();
+      this.startLogDrain(memory);
       
       this.updateStatus('WASM module loaded successfully!');
       this.enableRunButton();
@@ -107,6 +117,7 @@ class WasmRunner {
       while (!exports.async_cleanup()) {
         await this.delay(100);
       }
+      this.drainLog();
       this.updateStatus('Timer queue stopped');
 
     } catch (error) {
@@ -115,6 +126,22 @@ class WasmRunner {
     }
   }
 
+  // TRACE / LOG_* only write to the ring: nothing shows up unless it is
+  // read from here
+  private startLogDrain(memory: WebAssembly.Memory) {
+    const exports = this.instance?.exports as WasmExports | undefined;
+    if (!exports?.get_log_ring) return;
+
+    this.log = new LogRingDrain(memory, exports.get_log_ring());
+    setInterval(() => this.drainLog(), LOG_DRAIN_MS);
+  }
+
+  private drainLog() {
+    for (const line of this.log?.drain() ?? []) {
+      this.appendOutput(`WASM: ${line}`);
+    }
+  }
+
   private async delay(ms: number) {
     return await new Promise(resolve => setTimeout(resolve, ms));
   }
@@ -36,6 +36,10 @@ const handler = new ThreadMessageHandler({
             // console.log(log_line);
             postMessage(log_line);
           },
+          // host timer mode and profiling are native-host only
+          _host_timer_arm: (_delay_us: number) => {},
+          _host_queue_stopped: () => {},
+          _host_thread_exit: () => {},
       },
       wasi_snapshot_preview1: wasi.wasiImport,
       wasi: { ...wasiThreads.getImportObject().wasi },